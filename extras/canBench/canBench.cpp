@@ -0,0 +1,513 @@
+//--------------------------------------------------------
+// canBench.cpp
+//--------------------------------------------------------
+// Host benchmark of the CAN stack: myCANDriver, myCANFilter
+// and myCANFastPacket, over the in-memory loopback backend,
+// or SocketCAN with -i, replaying NMEA2000 traffic as fast as
+// the stack can take it.
+//
+// The traffic is either a candump log (candump -L), or a minute
+// of synthetic traffic from a handful of sources, at roughly the
+// rates of a small boat's network, including fast-packet PGNs
+// with a known payload that the receiver checks.
+//
+// A sending driver queues every frame, and a receiving driver,
+// with a filter for some of the PGNs and the temperature id,
+// passes what it accepts to the fast-packet reassembler. Reports
+// the bus load the traffic would be at 250 kbps, how much of it
+// the compiled MCP2515 filters would reject, the replay rate and
+// how much faster than real time it is, and the receiver's
+// counters and latency histogram.
+//
+// With -w, the receiver also captures all the traffic it sees
+// with myCANCapture, flushed to the file after every frame, for
+// extras/canCapture to convert. The receiver then also answers
+// each temperature frame on TEMP_ACK_ID, so that its polls see
+// frames it sent complete along with frames received, and the
+// capture is read back to check that its times are in order.
+//
+// Then a tester and an ECU exchange ISO-TP messages over their own
+// loopback bus: a long request, with flow control in blocks, and a
+// single frame reply. A request too long for the ECU to assemble,
+// which it answers with an overflow, and one on a channel that no
+// one answers, which times out, are both given up by the sender.
+//
+// Build on Linux:
+//
+//		g++ -O2 -I../host -I../.. canBench.cpp ../host/myCANSocket.cpp
+//			../../myCANDriver.cpp ../../myCANBackend.cpp ../../myCANFilter.cpp
+//			../../myCANFastPacket.cpp ../../myCANCapture.cpp ../host/hostShim.cpp
+//			-o canBench
+//
+//		./canBench [-i vcan0] [-w capture.bin] [candump.log]
+
+#include <myCANDriver.h>
+#include <myCANFilter.h>
+#include <myCANFastPacket.h>
+#include <myCANCapture.h>
+#include "../host/myCANSocket.h"
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#define BITRATE			250000
+#define SYNTH_SECONDS	60
+#define TEMP_CANID		0x036			// MY_TEMPERATURE_CANID
+#define TEMP_ACK_ID		0x037			// CAN_ACK_ID
+
+
+typedef struct
+{
+	uint32_t pgn;
+	int priority;
+	int source;
+	int period_ms;
+	int len;					// > 8 for fast-packet
+	bool wanted;
+} stream_t;
+
+static const stream_t streams[] =
+{
+	{ 127250,	2,	 10,	100,	8,		1 },	// heading
+	{ 127488,	2,	 20,	100,	8,		0 },	// engine rapid
+	{ 129025,	2,	 30,	100,	8,		0 },	// position rapid
+	{ 129026,	2,	 30,	250,	8,		0 },	// COG & SOG
+	{ 130306,	2,	 40,	100,	8,		1 },	// wind
+	{ 128267,	3,	 50,	1000,	8,		0 },	// depth
+	{ 127489,	2,	 20,	500,	26,		1 },	// engine dynamic
+	{ 129029,	3,	 30,	1000,	43,		1 },	// GNSS position
+	{ 129540,	6,	 30,	1000,	105,	0 },	// GNSS satellites
+	{ 126996,	6,	 40,	5000,	134,	0 },	// product information
+};
+
+#define NUM_STREAMS		(sizeof(streams) / sizeof(streams[0]))
+
+
+class filePrint : public Print
+{
+public:
+
+	filePrint(FILE *file) : m_file(file) {}
+	size_t write(uint8_t c) override  { return fputc(c,m_file) == EOF ? 0 : 1; }
+	size_t write(const uint8_t *buf, size_t len) override  { return fwrite(buf,1,len,m_file); }
+
+private:
+
+	FILE *m_file;
+};
+
+
+static bool checkCapture(const char *filename, int *tx, int *rx, int *back)
+	// counts the records, and the times that step back
+{
+	FILE *file = fopen(filename,"rb");
+	if (!file)
+		return false;
+	uint8_t header[CAN_CAPTURE_HEADER];
+	if (fread(header,1,CAN_CAPTURE_HEADER,file) != CAN_CAPTURE_HEADER ||
+		memcmp(header,CAN_CAPTURE_MAGIC,8))
+	{
+		fclose(file);
+		return false;
+	}
+
+	uint8_t rec[CAN_CAPTURE_RECORD + 8];
+	uint32_t last = 0;
+	*tx = *rx = *back = 0;
+	while (fread(rec,1,CAN_CAPTURE_RECORD,file) == CAN_CAPTURE_RECORD)
+	{
+		int len = rec[8] & CAN_CAP_LEN;
+		if (fread(rec + CAN_CAPTURE_RECORD,1,len,file) != (size_t) len)
+			break;
+		uint32_t time = rec[0] | (rec[1] << 8) | (rec[2] << 16) | ((uint32_t) rec[3] << 24);
+		if (*tx + *rx && (int32_t) (time - last) < 0)
+			(*back)++;
+		last = time;
+		if (rec[8] & CAN_CAP_TX)
+			(*tx)++;
+		else
+			(*rx)++;
+	}
+	fclose(file);
+	return true;
+}
+
+
+static void runIsoTp()
+{
+	myCANLoopbackBus bus;
+	myCANLoopback loop_tester(&bus);
+	myCANLoopback loop_ecu(&bus);
+	myCANDriver tester(&loop_tester);
+	myCANDriver ecu(&loop_ecu);
+	if (!tester.begin(BITRATE) || !ecu.begin(BITRATE))
+		return;
+
+	myCANFastPacket tp_tester;
+	myCANFastPacket tp_ecu;
+	int chan_tester = tp_tester.addIsoTp(0x7E8,0x7E0);
+	int chan_ecu = tp_ecu.addIsoTp(0x7E0,0x7E8);
+	int chan_nobody = tp_tester.addIsoTp(0x7E9,0x7E1);
+
+	static uint8_t data[CAN_TP_MAX_LEN];
+	for (int i=0; i<CAN_TP_MAX_LEN; i++)
+		data[i] = i * 7 + 1;
+
+	int received = 0;
+	int bad = 0;
+	int expect_len = 0;
+
+	auto step = [&](myCANDriver *can, myCANFastPacket *tp)
+	{
+		can->poll();
+		int n;
+		const myCANFrame *frames = can->peek(&n);
+		for (int i=0; i<n; i++)
+		{
+			const myCANMessage *msg = tp->process(&frames[i]);
+			if (!msg)
+				continue;
+			received++;
+			if (msg->len != expect_len || memcmp(msg->data,data,expect_len))
+				bad++;
+			tp->release(msg);
+		}
+		can->consume(n);
+		tp->transmit(can);
+	};
+
+	auto exchange = [&](myCANFastPacket *tp, int chan, int len)
+	{
+		expect_len = len;
+		tp->sendIsoTp(chan,data,len);
+		uint32_t start = micros();
+		while (tp->isoTpBusy(chan) && micros() - start < 2 * CAN_TP_TIMEOUT_MS * 1000)
+		{
+			step(&tester,&tp_tester);
+			step(&ecu,&tp_ecu);
+		}
+		// sent is as far as the driver's queue
+
+		for (int i=0; i<2 || tester.txPending() || ecu.txPending(); i++)
+		{
+			step(&tester,&tp_tester);
+			step(&ecu,&tp_ecu);
+		}
+	};
+
+	exchange(&tp_tester,chan_tester,CAN_FP_MAX_LEN);	// 32 frames, 4 flow controls
+	exchange(&tp_ecu,chan_ecu,5);						// a single frame
+	exchange(&tp_tester,chan_tester,CAN_FP_MAX_LEN + 1);
+	exchange(&tp_tester,chan_nobody,100);
+
+	printf("iso-tp: received(%d of 2) bad(%d) sent(%u of 2) overflows(%u) aborts(%u of 2) frames(%u)\n",
+		received,bad,
+		tp_tester.getIsoTpSent() + tp_ecu.getIsoTpSent(),
+		tp_ecu.getOverflows(),
+		tp_tester.getIsoTpAborts(),
+		bus.getFrames());
+}
+
+
+static uint8_t payloadByte(uint32_t pgn, int source, int i)
+	// known contents, so the reassembly can be checked
+{
+	return (pgn * 7 + source * 13 + i) & 0xff;
+}
+
+
+static void synthesize(std::vector<myCANFrame> *traffic)
+{
+	myCANFastPacket fp[NUM_STREAMS];
+	uint8_t data[CAN_FP_MAX_LEN];
+	myCANFrame frames[CAN_FP_MAX_FRAMES];
+
+	for (unsigned s=0; s<NUM_STREAMS; s++)
+	{
+		const stream_t *st = &streams[s];
+		uint32_t id = myCANFastPacket::makeId(st->priority,st->pgn,st->source);
+		for (int i=0; i<st->len; i++)
+			data[i] = payloadByte(st->pgn,st->source,i);
+
+		// offset each stream a little so they do not all start together
+		for (uint32_t t = s * 3000; t < SYNTH_SECONDS * 1000000UL; t += st->period_ms * 1000)
+		{
+			int n;
+			if (st->len > 8)
+				n = fp[s].segment(id,data,st->len,frames,CAN_FP_MAX_FRAMES);
+			else
+			{
+				frames[0].id = id;
+				frames[0].flags = CAN_FRAME_EXT;
+				frames[0].len = 8;
+				memcpy(frames[0].data,data,8);
+				n = 1;
+			}
+			for (int i=0; i<n; i++)
+			{
+				frames[i].time = t + i * 600;
+				traffic->push_back(frames[i]);
+			}
+		}
+	}
+
+	// the temperature sensor, and another 11 bit id at 20Hz
+
+	for (uint32_t t = 0; t < SYNTH_SECONDS * 1000000UL; t += 50000)
+	{
+		myCANFrame frame = {};
+		frame.time = t;
+		frame.id = (t % 1000000) ? 0x100 : TEMP_CANID;
+		frame.len = 8;
+		traffic->push_back(frame);
+	}
+
+	std::stable_sort(traffic->begin(),traffic->end(),
+		[](const myCANFrame &a, const myCANFrame &b) { return a.time < b.time; });
+}
+
+
+static bool loadLog(const char *filename, std::vector<myCANFrame> *traffic)
+	// candump -L lines: (1436509052.249713) can0 0CF00400#FF00FFFF
+{
+	FILE *file = fopen(filename,"r");
+	if (!file)
+	{
+		printf("could not open %s\n",filename);
+		return false;
+	}
+
+	char line[256];
+	double first = -1;
+	while (fgets(line,sizeof(line),file))
+	{
+		double secs;
+		char iface[32];
+		char text[128];
+		if (sscanf(line," (%lf) %31s %127s",&secs,iface,text) != 3)
+			continue;
+		char *hash = strchr(text,'#');
+		if (!hash)
+			continue;
+		*hash++ = 0;
+
+		myCANFrame frame = {};
+		if (first < 0)
+			first = secs;
+		frame.time = (secs - first) * 1000000;
+		frame.id = strtoul(text,NULL,16);
+		frame.flags = strlen(text) > 3 ? CAN_FRAME_EXT : 0;
+		if (*hash == 'R')
+			frame.flags |= CAN_FRAME_RTR;
+		else
+		{
+			while (hash[0] && hash[1] && frame.len < 8)
+			{
+				char hex[3] = { hash[0], hash[1], 0 };
+				frame.data[frame.len++] = strtoul(hex,NULL,16);
+				hash += 2;
+			}
+		}
+		traffic->push_back(frame);
+	}
+	fclose(file);
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *iface = NULL;
+	const char *log_file = NULL;
+	const char *capture_file = NULL;
+	for (int i=1; i<argc; i++)
+	{
+		if (!strcmp(argv[i],"-i") && i + 1 < argc)
+			iface = argv[++i];
+		else if (!strcmp(argv[i],"-w") && i + 1 < argc)
+			capture_file = argv[++i];
+		else
+			log_file = argv[i];
+	}
+
+	std::vector<myCANFrame> traffic;
+	if (log_file)
+	{
+		if (!loadLog(log_file,&traffic))
+			return 1;
+	}
+	else
+		synthesize(&traffic);
+	if (traffic.empty())
+	{
+		printf("no traffic\n");
+		return 1;
+	}
+
+	uint64_t bits = 0;
+	for (const myCANFrame &frame : traffic)
+		bits += myCANDriver::frameBits(&frame);
+	double duration = (traffic.back().time + 1000) / 1000000.0;
+	printf("traffic: %d frames in %.1fs, %.1f%% bus load at %d bps\n",
+		(int) traffic.size(),duration,100.0 * bits / (duration * BITRATE),BITRATE);
+
+	// the receiver's filter, and what the MCP2515 filters would let through
+
+	myCANFilter filter;
+	filter.addId(TEMP_CANID);
+	for (unsigned s=0; s<NUM_STREAMS; s++)
+		if (streams[s].wanted)
+			filter.addPgn(streams[s].pgn);
+	filter.compile();
+
+	int hw_accepts = 0;
+	int sw_accepts = 0;
+	for (const myCANFrame &frame : traffic)
+	{
+		if (filter.hwAccepts(&frame))
+			hw_accepts++;
+		if (filter.match(&frame))
+			sw_accepts++;
+	}
+	filter.report();
+	printf("    MCP2515 filters would reject %.1f%%, software %d more, accepting %d\n",
+		100.0 * (traffic.size() - hw_accepts) / traffic.size(),
+		hw_accepts - sw_accepts,sw_accepts);
+
+	// the two nodes
+
+	myCANLoopbackBus bus;
+	myCANLoopback loop_tx(&bus);
+	myCANLoopback loop_rx(&bus);
+	myCANSocket sock_tx(iface ? iface : "");
+	myCANSocket sock_rx(iface ? iface : "");
+	myCANBackend *backend_tx = iface ? (myCANBackend *) &sock_tx : &loop_tx;
+	myCANBackend *backend_rx = iface ? (myCANBackend *) &sock_rx : &loop_rx;
+
+	myCANDriver tx(backend_tx);
+	myCANDriver rx(backend_rx);
+	if (!tx.begin(BITRATE) || !rx.begin(BITRATE))
+		return 1;
+	rx.setFilters(&filter);
+
+	static myCANCapture capture;
+	FILE *capture_fp = NULL;
+	if (capture_file)
+	{
+		capture_fp = fopen(capture_file,"wb");
+		if (!capture_fp)
+		{
+			printf("could not create %s\n",capture_file);
+			return 1;
+		}
+		rx.setCapture(&capture);
+	}
+	filePrint capture_out(capture_fp);
+
+	myCANFastPacket fp;
+	for (unsigned s=0; s<NUM_STREAMS; s++)
+		if (streams[s].len > 8)
+			fp.addPgn(streams[s].pgn);
+
+	int messages = 0;
+	int fast_messages = 0;
+	int bad_messages = 0;
+	int temp_frames = 0;
+
+	auto drain = [&]()
+	{
+		tx.poll();
+		rx.poll();
+		int n;
+		const myCANFrame *frames = rx.peek(&n);
+		for (int i=0; i<n; i++)
+		{
+			if (!(frames[i].flags & CAN_FRAME_EXT))
+			{
+				if (frames[i].id == TEMP_CANID)
+				{
+					temp_frames++;
+					if (capture_fp)
+					{
+						myCANFrame ack = frames[i];
+						ack.id = TEMP_ACK_ID;
+						rx.send(&ack);
+					}
+				}
+				continue;
+			}
+			const myCANMessage *msg = fp.process(&frames[i]);
+			if (!msg)
+				continue;
+			messages++;
+			if (msg->len > 8)
+			{
+				fast_messages++;
+				for (int j=0; j<msg->len; j++)
+					if (msg->data[j] != payloadByte(msg->pgn,msg->source,j))
+					{
+						bad_messages++;
+						break;
+					}
+			}
+			fp.release(msg);
+		}
+		rx.consume(n);
+		if (capture_fp)
+			capture.flush(&capture_out);
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	for (const myCANFrame &frame : traffic)
+	{
+		while (!tx.send(&frame))
+			drain();
+		drain();
+	}
+
+	// let the last frames through, which on SocketCAN takes a moment
+
+	auto idle = std::chrono::steady_clock::now();
+	while (tx.txPending() ||
+		std::chrono::steady_clock::now() - idle < std::chrono::milliseconds(iface ? 100 : 0))
+		drain();
+	drain();
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int expected_fast = 0;
+	for (unsigned s=0; s<NUM_STREAMS; s++)
+		if (streams[s].wanted && streams[s].len > 8)
+			expected_fast += (SYNTH_SECONDS * 1000 - s * 3 + streams[s].period_ms - 1) / streams[s].period_ms;
+
+	printf("replay over %s: %.3fs, %.0f frames/s, %.0fx real time\n",
+		iface ? iface : "loopback",wall,traffic.size() / wall,duration / wall);
+
+	myCANStats stats;
+	rx.getStats(&stats);
+	printf("    rx frames(%u) sw_rejected(%u) ring_overflows(%u) chip_overflows(%u)\n",
+		stats.rx_frames,stats.sw_rejected,stats.ring_overflows,stats.chip_overflows);
+	printf("    messages(%d) fast-packet(%d",messages,fast_messages);
+	if (!log_file)
+		printf(" of %d",expected_fast);
+	printf(") bad(%d) temperature frames(%d)\n",bad_messages,temp_frames);
+	printf("    fast-packet completed(%u) timeouts(%u) restarts(%u) evictions(%u) dropped(%u)\n",
+		fp.getCompleted(),fp.getTimeouts(),fp.getRestarts(),fp.getEvictions(),fp.getDropped());
+	printf("    latency to the application p50(%uus) p99(%uus) max(%uus)\n",
+		myCANDriver::latencyPercentile(&stats,50),
+		myCANDriver::latencyPercentile(&stats,99),
+		stats.latency_max);
+	if (capture_fp)
+	{
+		fclose(capture_fp);
+		printf("    captured(%u) lost(%u) to %s\n",capture.getFrames(),capture.getLost(),capture_file);
+		int cap_tx,cap_rx,cap_back;
+		if (!checkCapture(capture_file,&cap_tx,&cap_rx,&cap_back))
+			printf("    could not read back %s\n",capture_file);
+		else
+			printf("    capture tx(%d) rx(%d) times out of order(%d)\n",cap_tx,cap_rx,cap_back);
+	}
+
+	runIsoTp();
+	return 0;
+}
@@ -0,0 +1,193 @@
+//--------------------------------------------------------
+// canCapture.cpp
+//--------------------------------------------------------
+// Converts a myCANCapture stream, as flushed to a file, or
+// saved from Serial or telnet, to candump -L text, for can-utils
+// and the NMEA2000 tools that read it, or to Vector ASC.
+//
+// The capture's 32 bit microsecond times wrap every 71 minutes,
+// which is unwound as long as the bus is never quiet for half that.
+// Times may step back a little, as a frame sent is recorded when
+// its completion is seen, and the driver stamps received frames
+// with the earlier INT edge; these are shown at the time before.
+// Times are from the first frame, as the ESP32 has no clock.
+// A stream restarted into the same file, with a new header, is
+// followed through, dropping a record cut short before it. Frames
+// the capture lost are reported on stderr, and counted at the end.
+//
+// Build on Linux:
+//
+//		g++ -O2 -I../.. canCapture.cpp -o canCapture
+//
+//		./canCapture [-a] [-i can0] capture.bin > capture.log
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// the definitions from myCANCapture.h, which needs Arduino.h
+
+#define CAN_CAPTURE_MAGIC			"myCANcap"
+#define CAN_CAPTURE_VERSION			1
+#define CAN_CAPTURE_HEADER			12
+#define CAN_CAPTURE_RECORD			9
+
+#define CAN_CAP_LEN					0x0F
+#define CAN_CAP_EXT					0x10
+#define CAN_CAP_RTR					0x20
+#define CAN_CAP_TX					0x40
+#define CAN_CAP_LOST				0x80
+
+
+static uint32_t get32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+static const uint8_t *findHeader(const uint8_t *p, const uint8_t *end)
+{
+	for (; p + CAN_CAPTURE_HEADER <= end; p++)
+		if (!memcmp(p,CAN_CAPTURE_MAGIC,8))
+			return p;
+	return end;
+}
+
+
+int main(int argc, char **argv)
+{
+	bool asc = false;
+	const char *iface = "can0";
+	const char *filename = NULL;
+	for (int i=1; i<argc; i++)
+	{
+		if (!strcmp(argv[i],"-a"))
+			asc = true;
+		else if (!strcmp(argv[i],"-i") && i + 1 < argc)
+			iface = argv[++i];
+		else
+			filename = argv[i];
+	}
+	if (!filename)
+	{
+		fprintf(stderr,"usage: canCapture [-a] [-i can0] capture.bin\n");
+		return 1;
+	}
+
+	FILE *file = fopen(filename,"rb");
+	if (!file)
+	{
+		fprintf(stderr,"could not open %s\n",filename);
+		return 1;
+	}
+	std::vector<uint8_t> buf;
+	uint8_t chunk[4096];
+	size_t got;
+	while ((got = fread(chunk,1,sizeof(chunk),file)) > 0)
+		buf.insert(buf.end(),chunk,chunk + got);
+	fclose(file);
+
+	const uint8_t *end = buf.data() + buf.size();
+	const uint8_t *p = buf.data();
+	if (findHeader(p,end) != p)
+	{
+		fprintf(stderr,"%s is not a myCANCapture stream\n",filename);
+		return 1;
+	}
+
+	if (asc)
+	{
+		printf("date Thu Jan 1 12:00:00.000 am 1970\n");
+		printf("base hex  timestamps absolute\n");
+		printf("no internal events logged\n");
+		printf("Begin Triggerblock\n");
+	}
+
+	int64_t now = 0;			// may step back
+	int64_t shown = 0;			// never does
+	uint32_t last = 0;
+	bool first = true;
+	uint32_t frames = 0;
+	uint32_t lost = 0;
+	uint32_t partial = 0;
+	const uint8_t *next_header = p;
+
+	while (p + CAN_CAPTURE_RECORD <= end)
+	{
+		if (p == next_header)
+		{
+			if (p[8] != CAN_CAPTURE_VERSION)
+			{
+				fprintf(stderr,"%s is version %d, not %d\n",filename,p[8],CAN_CAPTURE_VERSION);
+				return 1;
+			}
+			p += CAN_CAPTURE_HEADER;
+			next_header = findHeader(p,end);
+			continue;
+		}
+
+		uint32_t time = get32(p);
+		uint32_t id = get32(p + 4);
+		uint8_t flags = p[8];
+		int len = flags & CAN_CAP_LEN;
+		const uint8_t *data = p + CAN_CAPTURE_RECORD;
+		if (len > 8 || data + len > next_header)
+		{
+			// cut short by a restart, or the end of the file
+
+			partial++;
+			p = next_header;
+			continue;
+		}
+		p = data + len;
+
+		if (first)
+			last = time;
+		first = false;
+		now += (int32_t) (time - last);
+		last = time;
+		if (now > shown)
+			shown = now;
+		unsigned secs = shown / 1000000;
+		unsigned usecs = shown % 1000000;
+
+		if (flags & CAN_CAP_LOST)
+		{
+			lost += id;
+			fprintf(stderr,"%u.%06u lost %u frames\n",secs,usecs,id);
+			continue;
+		}
+		frames++;
+
+		if (asc)
+		{
+			char text[16];
+			snprintf(text,sizeof(text),flags & CAN_CAP_EXT ? "%Xx" : "%X",id);
+			printf("%4u.%06u 1  %-15s %s   ",secs,usecs,text,flags & CAN_CAP_TX ? "Tx" : "Rx");
+			if (flags & CAN_CAP_RTR)
+				printf("r\n");
+			else
+			{
+				printf("d %d",len);
+				for (int i=0; i<len; i++)
+					printf(" %02X",data[i]);
+				printf("\n");
+			}
+		}
+		else
+		{
+			printf("(%u.%06u) %s ",secs,usecs,iface);
+			printf(flags & CAN_CAP_EXT ? "%08X#" : "%03X#",id);
+			if (flags & CAN_CAP_RTR)
+				printf("R");
+			for (int i=0; i<len; i++)
+				printf("%02X",data[i]);
+			printf("\n");
+		}
+	}
+	if (asc)
+		printf("End TriggerBlock\n");
+	fprintf(stderr,"%u frames, %u lost, %u partial records\n",frames,lost,partial);
+	return 0;
+}
@@ -0,0 +1,67 @@
+//--------------------------------------------------------
+// formatBench.cpp
+//--------------------------------------------------------
+// Host benchmark of myFastFormat against snprintf() for the
+// kinds of lines I typically log: integers, hex ids and
+// fixed point temperatures in fixed width fields.
+//
+// Build on Linux:
+//
+//		g++ -O2 -I../.. formatBench.cpp -o formatBench
+
+#include <myFastFormat.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#define ITERATIONS		2000000
+#define WIDTH			40
+
+static volatile uint32_t sink;
+
+
+template <class FXN>
+static double timeIt(const char *name, FXN fxn)
+{
+	char buf[WIDTH + 1];
+	auto start = std::chrono::steady_clock::now();
+	for (int i=0; i<ITERATIONS; i++)
+	{
+		fxn(buf,i);
+		sink += buf[i % WIDTH];
+	}
+	auto end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double,std::nano>(end - start).count() / ITERATIONS;
+	printf("%-12s %8.1f ns/line   [%s]\n",name,ns,buf);
+	return ns;
+}
+
+
+int main(int argc, char **argv)
+{
+	printf("myFastFormat vs snprintf, %d lines of %d characters\n\n",ITERATIONS,WIDTH);
+
+	double slow = timeIt("snprintf",[](char *buf, int i)
+	{
+		int len = snprintf(buf,WIDTH + 1,"%5d %04X %7.2f %7.2f",
+			i % 100000, i & 0xffff, (i % 100000) * 0.01f, (int16_t) i / 128.0f);
+		if (len < WIDTH)
+		{
+			memset(&buf[len],' ',WIDTH - len);
+			buf[WIDTH] = 0;
+		}
+	});
+
+	double fast = timeIt("myFastFormat",[](char *buf, int i)
+	{
+		myFastFormat(buf,WIDTH)
+			.dec<5>(i % 100000).chr(' ')
+			.hex<4>(i & 0xffff).chr(' ')
+			.fixed<7,2>((i % 100000) * 0.01f).chr(' ')
+			.fixedRaw<7,2,7>((int16_t) i)
+			.end();
+	});
+
+	printf("\nspeedup %.1fx\n",slow / fast);
+	return 0;
+}
@@ -0,0 +1,2 @@
+// Adafruit_GFX.h includes this, but nothing in it is needed on the host
+#pragma once
@@ -0,0 +1,76 @@
+//--------------------------------------------------------
+// extras/host/Arduino.h
+//--------------------------------------------------------
+// Just enough of the Arduino environment to compile the
+// hardware independent parts of this library, and the
+// headless / simulated backends, on a Linux host for
+// testing and benchmarking. Compile with -DARDUINO=100
+// so that Adafruit_GFX.h picks up Print.h from here.
+// ESP32 is NOT defined, which removes the hardware drivers
+// and FreeRTOS tasks from the library sources. MY_HOST_BUILD
+// removes what any Arduino board has, but a host does not,
+// like the OneWire library.
+
+#pragma once
+
+#define MY_HOST_BUILD
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+
+#include "Print.h"
+
+#ifndef PROGMEM
+	#define PROGMEM
+#endif
+
+#define HEX		16
+#define DEC		10
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+extern uint32_t millis();
+extern uint32_t micros();
+extern void delay(uint32_t ms);
+extern void delayMicroseconds(uint32_t us);
+
+// host only: simulators may switch the clock to virtual time,
+// which only moves when they, or delay(), advance it.
+
+extern void hostSetVirtualTime(bool on);
+extern void hostAdvanceMicros(uint32_t us);
+
+class __FlashStringHelper;
+
+class String
+	// minimal std::string based String for the
+	// few usages in this library and Adafruit_GFX
+{
+public:
+
+	String(const char *s = "") : m_str(s) {}
+	String(int value, int base = DEC)
+	{
+		char buf[16];
+		snprintf(buf,sizeof(buf),base == HEX ? "%x" : "%d",value);
+		m_str = buf;
+	}
+
+	String operator+(const String &s) const { String r; r.m_str = m_str + s.m_str; return r; }
+	friend String operator+(const char *a, const String &b) { return String(a) + b; }
+	String &operator+=(const String &s) { m_str += s.m_str; return *this; }
+
+	unsigned int length() const { return m_str.length(); }
+	const char *c_str() const { return m_str.c_str(); }
+
+private:
+
+	std::string m_str;
+};
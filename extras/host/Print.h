@@ -0,0 +1,49 @@
+//--------------------------------------------------------
+// extras/host/Print.h
+//--------------------------------------------------------
+// minimal host version of the Arduino Print class
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+
+class Print
+{
+public:
+
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buf, size_t len)
+	{
+		size_t n = 0;
+		while (len--)
+			n += write(*buf++);
+		return n;
+	}
+	size_t write(const char *s) { return s ? write((const uint8_t *) s, strlen(s)) : 0; }
+
+	virtual void flush() {}
+
+	size_t print(const char *s) { return write(s); }
+	size_t print(char c) { return write((uint8_t) c); }
+	size_t print(int value) { char buf[16]; snprintf(buf,sizeof(buf),"%d",value); return write(buf); }
+	size_t println() { return write("\r\n"); }
+	size_t println(const char *s) { return print(s) + println(); }
+	size_t println(int value) { return print(value) + println(); }
+
+	size_t printf(const char *format, ...)
+	{
+		char buf[256];
+		va_list var;
+		va_start(var, format);
+		vsnprintf(buf,sizeof(buf),format,var);
+		va_end(var);
+		return write(buf);
+	}
+};
@@ -0,0 +1,72 @@
+//--------------------------------------------------------
+// extras/host/hostShim.cpp
+//--------------------------------------------------------
+// implements the host Arduino.h and myDebug.h
+
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point start_time =
+	std::chrono::steady_clock::now();
+
+static bool virtual_time;
+static uint64_t virtual_us;
+
+
+void hostSetVirtualTime(bool on)
+{
+	virtual_time = on;
+}
+
+void hostAdvanceMicros(uint32_t us)
+{
+	virtual_us += us;
+}
+
+
+uint32_t millis()
+{
+	if (virtual_time)
+		return virtual_us / 1000;
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start_time).count();
+}
+
+uint32_t micros()
+{
+	if (virtual_time)
+		return virtual_us;
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start_time).count();
+}
+
+void delay(uint32_t ms)
+{
+	if (virtual_time)
+		virtual_us += (uint64_t) ms * 1000;
+	else
+		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+	if (virtual_time)
+		virtual_us += us;
+	else
+		std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+
+void display_fxn(const char *alt_color, int level, const char *format, ...)
+{
+	if (level > 0)
+		return;
+	va_list var;
+	va_start(var, format);
+	if (alt_color)
+		fputs(alt_color,stdout);
+	vprintf(format,var);
+	va_end(var);
+	fputs("\n",stdout);
+}
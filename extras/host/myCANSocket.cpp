@@ -0,0 +1,199 @@
+//--------------------------------------------------------
+// extras/host/myCANSocket.cpp
+//--------------------------------------------------------
+
+#include "myCANSocket.h"
+#include <myCANFilter.h>
+#include <myDebug.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+
+myCANSocket::myCANSocket(const char *ifname) :
+	m_ifname(ifname),
+	m_fd(-1),
+	m_tx_pending(0),
+	m_tx_done(0),
+	m_overflows(0)
+{}
+
+
+myCANSocket::~myCANSocket()
+{
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+
+bool myCANSocket::begin(uint32_t bitrate)
+{
+	m_fd = socket(PF_CAN,SOCK_RAW,CAN_RAW);
+	if (m_fd < 0)
+	{
+		my_error("myCANSocket: socket() errno=%d",errno);
+		return false;
+	}
+
+	struct ifreq ifr;
+	memset(&ifr,0,sizeof(ifr));
+	strncpy(ifr.ifr_name,m_ifname,IFNAMSIZ - 1);
+	if (ioctl(m_fd,SIOCGIFINDEX,&ifr) < 0)
+	{
+		my_error("myCANSocket: no interface %s",m_ifname);
+		close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+
+	struct sockaddr_can addr;
+	memset(&addr,0,sizeof(addr));
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	if (bind(m_fd,(struct sockaddr *) &addr,sizeof(addr)) < 0)
+	{
+		my_error("myCANSocket: bind(%s) errno=%d",m_ifname,errno);
+		close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+
+	// the kernel counts the frames it drops for the socket
+
+	int on = 1;
+	setsockopt(m_fd,SOL_SOCKET,SO_RXQ_OVFL,&on,sizeof(on));
+	fcntl(m_fd,F_SETFL,fcntl(m_fd,F_GETFL) | O_NONBLOCK);
+	return true;
+}
+
+
+bool myCANSocket::setFilters(myCANFilter *filter)
+{
+	if (m_fd < 0)
+		return false;
+
+	struct can_filter filters[CAN_MAX_FILTER_IDS];
+	int num = filter ? filter->getNumIds() : 0;
+	for (int i=0; i<num; i++)
+	{
+		uint32_t value;
+		uint32_t mask;
+		bool ext;
+		filter->getId(i,&value,&mask,&ext);
+		filters[i].can_id = value | (ext ? CAN_EFF_FLAG : 0);
+		filters[i].can_mask = mask | CAN_EFF_FLAG;
+			// not CAN_RTR_FLAG, as the MCP2515 filters, and myCANFilter,
+			// accept remote frames of an id along with its data frames
+	}
+
+	// no filters is everything
+	if (!num)
+	{
+		filters[0].can_id = 0;
+		filters[0].can_mask = 0;
+		num = 1;
+	}
+
+	if (setsockopt(m_fd,SOL_CAN_RAW,CAN_RAW_FILTER,filters,num * sizeof(filters[0])) < 0)
+	{
+		my_error("myCANSocket: CAN_RAW_FILTER errno=%d",errno);
+		return false;
+	}
+	return true;
+}
+
+
+bool myCANSocket::write(const myCANFrame *frame)
+{
+	struct can_frame msg;
+	memset(&msg,0,sizeof(msg));
+	msg.can_id = frame->id |
+		(frame->flags & CAN_FRAME_EXT ? CAN_EFF_FLAG : 0) |
+		(frame->flags & CAN_FRAME_RTR ? CAN_RTR_FLAG : 0);
+	msg.can_dlc = frame->len > 8 ? 8 : frame->len;
+	memcpy(msg.data,frame->data,8);
+	return ::write(m_fd,&msg,sizeof(msg)) == sizeof(msg);
+}
+
+
+void myCANSocket::load(int slot, const myCANFrame *frame)
+{
+	if (write(frame))
+	{
+		m_tx_done = 1;
+		return;
+	}
+	if (errno == EAGAIN || errno == ENOBUFS)
+	{
+		m_tx_frame = *frame;
+		m_tx_pending = 1;
+		return;
+	}
+	my_error("myCANSocket: write() errno=%d",errno);
+	m_tx_done = 1;
+}
+
+
+uint8_t myCANSocket::getEvents()
+{
+	if (m_fd < 0)
+		return 0;
+
+	uint8_t events = 0;
+	if (m_tx_pending && write(&m_tx_frame))
+	{
+		m_tx_pending = 0;
+		m_tx_done = 1;
+	}
+	if (m_tx_done)
+	{
+		events |= CAN_EVENT_TX0;
+		m_tx_done = 0;
+	}
+
+	struct pollfd pfd;
+	pfd.fd = m_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd,1,0) > 0 && (pfd.revents & POLLIN))
+		events |= CAN_EVENT_RX;
+	return events;
+}
+
+
+bool myCANSocket::read(myCANFrame *frame)
+{
+	struct can_frame msg;
+	char control[CMSG_SPACE(sizeof(uint32_t))];
+	struct iovec iov;
+	iov.iov_base = &msg;
+	iov.iov_len = sizeof(msg);
+	struct msghdr hdr;
+	memset(&hdr,0,sizeof(hdr));
+	hdr.msg_iov = &iov;
+	hdr.msg_iovlen = 1;
+	hdr.msg_control = control;
+	hdr.msg_controllen = sizeof(control);
+
+	if (m_fd < 0 || recvmsg(m_fd,&hdr,0) != sizeof(msg))
+		return false;
+
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr,cmsg))
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+			memcpy(&m_overflows,CMSG_DATA(cmsg),sizeof(uint32_t));
+
+	frame->flags =
+		(msg.can_id & CAN_EFF_FLAG ? CAN_FRAME_EXT : 0) |
+		(msg.can_id & CAN_RTR_FLAG ? CAN_FRAME_RTR : 0);
+	frame->id = msg.can_id & (frame->flags & CAN_FRAME_EXT ? CAN_EFF_MASK : CAN_SFF_MASK);
+	frame->len = msg.can_dlc > 8 ? 8 : msg.can_dlc;
+	memcpy(frame->data,msg.data,8);
+	return true;
+}
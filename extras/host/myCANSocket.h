@@ -0,0 +1,53 @@
+//--------------------------------------------------------
+// extras/host/myCANSocket.h
+//--------------------------------------------------------
+// myCANBackend for Linux SocketCAN, so that myCANDriver, and
+// everything above it, can run on a workstation against a real
+// interface or a virtual one:
+//
+//		sudo modprobe vcan
+//		sudo ip link add dev vcan0 type vcan
+//		sudo ip link set up vcan0
+//
+// The bitrate is set with ip link, not by begin(). The socket is
+// non-blocking, and a frame the kernel has no room for is retried
+// from getEvents(). The kernel applies the myCANFilter ids exactly,
+// as CAN_RAW_FILTER, so the software filter has nothing left to do.
+// Like the MCP2515 filters, they pass remote frames along with the
+// data frames of their ids.
+// Frames sent by one socket are seen by every other socket on the
+// same interface, including those in the same process.
+
+#pragma once
+
+#include <myCANBackend.h>
+
+
+class myCANSocket final : public myCANBackend
+{
+public:
+
+	myCANSocket(const char *ifname);
+	~myCANSocket();
+
+	bool begin(uint32_t bitrate) override;
+	bool setFilters(myCANFilter *filter) override;
+
+	uint8_t getEvents() override;
+	bool read(myCANFrame *frame) override;
+	void load(int slot, const myCANFrame *frame) override;
+
+	uint32_t getOverflows() override  { return m_overflows; }
+		// frames the kernel dropped for this socket
+
+private:
+
+	const char *m_ifname;
+	int m_fd;
+	bool m_tx_pending;
+	bool m_tx_done;
+	myCANFrame m_tx_frame;
+	uint32_t m_overflows;
+
+	bool write(const myCANFrame *frame);
+};
@@ -0,0 +1,18 @@
+//--------------------------------------------------------
+// extras/host/myDebug.h
+//--------------------------------------------------------
+// host stand-in for the myDebug library; levels > 0 are
+// suppressed and everything goes to stdout.
+
+#pragma once
+
+#include <Arduino.h>
+
+extern void display_fxn(const char *alt_color, int level, const char *format, ...);
+
+#define display(level, format, ...)		display_fxn(0, level, format, __VA_ARGS__)
+#define warning(level, format, ...)		display_fxn("WARNING: ", level, format, __VA_ARGS__)
+#define my_error(format, ...)			display_fxn("ERROR: ", 0, format, __VA_ARGS__)
+
+#define proc_entry()
+#define proc_leave()
@@ -0,0 +1,109 @@
+//--------------------------------------------------------
+// oledBench.cpp
+//--------------------------------------------------------
+// Host benchmark for myOledMonitor using the headless driver.
+// Drives println() at a range of line rates, for each display,
+// font size and rotation, and simulates the update task by
+// calling refresh() once per frame at OLED_MAX_FPS.
+//
+// Reports, per configuration:
+//
+//		bytes/line	bytes that would have crossed SPI/I2C per line printed
+//		trans/line	bus transactions per line printed
+//		us/frame	average host time spent in refresh()
+//		max_lps		lines/s the renderer could sustain at that cost
+//
+// Build on Linux, as one command, with GFX = path to the Adafruit_GFX library:
+//
+//		g++ -O2 -DARDUINO=100 -I../host -I../.. -I$GFX -o oledBench
+//			oledBench.cpp ../host/hostShim.cpp
+//			../../myOledMonitor.cpp ../../myOledHeadless.cpp
+//			$GFX/Adafruit_GFX.cpp $GFX/glcdfont.c
+
+#include <myOledMonitor.h>
+#include <myOledHeadless.h>
+#include <chrono>
+
+#define SIM_SECONDS		10
+
+static const uint16_t drivers[] = {
+	DRIVER_SSD1306_128x32,
+	DRIVER_SSD1306_128x64,
+	DRIVER_ST7789_320x170 };
+
+static const char *driver_names[] = {
+	"SSD1306_128x32",
+	"SSD1306_128x64",
+	"ST7789_320x170" };
+
+static const int rates[] = { 1, 10, 100, 1000 };
+
+#define NUM_DRIVERS		(sizeof(drivers)/sizeof(drivers[0]))
+#define NUM_RATES		(sizeof(rates)/sizeof(rates[0]))
+
+
+
+static void runOne(int d, int font_size, int rotation, int rate)
+{
+	myOledMonitor mon(drivers[d] | DRIVER_HEADLESS, font_size, true);
+	mon.init(rotation);
+	myOledHeadless *headless = myOledMonitor::getHeadless();
+	headless->resetCounters();
+
+	int frames = SIM_SECONDS * OLED_MAX_FPS;
+	double per_frame = (double) rate / OLED_MAX_FPS;
+	double pending = 0;
+	uint32_t lines = 0;
+	double render_us = 0;
+
+	for (int f=0; f<frames; f++)
+	{
+		pending += per_frame;
+		while (pending >= 1.0)
+		{
+			myOledMonitor::println("line %u t=%d.%02d",lines,lines/7,lines%100);
+			lines++;
+			pending -= 1.0;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		myOledMonitor::refresh();
+		auto end = std::chrono::steady_clock::now();
+		render_us += std::chrono::duration<double,std::micro>(end - start).count();
+	}
+
+	double us_per_frame = render_us / frames;
+	double max_lps = render_us > 0 ? lines / (render_us / 1000000.0) : 0;
+
+	printf("%-16s %4d %3d %6d %8u %10.1f %10.2f %10.1f %12.0f\n",
+		driver_names[d],
+		font_size,
+		rotation,
+		rate,
+		lines,
+		lines ? (double) headless->m_bus_bytes / lines : 0.0,
+		lines ? (double) headless->m_transactions / lines : 0.0,
+		us_per_frame,
+		max_lps);
+}
+
+
+int main(int argc, char **argv)
+{
+	printf("myOledMonitor headless benchmark: %d simulated seconds at %d fps\n\n",SIM_SECONDS,OLED_MAX_FPS);
+	printf("%-16s %4s %3s %6s %8s %10s %10s %10s %12s\n",
+		"driver","font","rot","rate","lines","bytes/line","trans/line","us/frame","max_lps");
+
+	for (unsigned d=0; d<NUM_DRIVERS; d++)
+	{
+		for (int font_size=1; font_size<=3; font_size++)
+		{
+			for (int rotation=0; rotation<4; rotation++)
+			{
+				for (unsigned r=0; r<NUM_RATES; r++)
+					runOne(d,font_size,rotation,rates[r]);
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,492 @@
+//---------------------------------------------
+// myOneWireSim.cpp
+//---------------------------------------------
+
+#include "myOneWireSim.h"
+#include <math.h>
+
+// states after a reset
+
+#define SIM_ROM_CMD			0
+#define SIM_MATCH			1
+#define SIM_FUNCTION		2
+#define SIM_SEARCH			3
+#define SIM_CONVERTING		4
+#define SIM_READ_SCRATCH	5
+#define SIM_WRITE_SCRATCH	6
+#define SIM_READ_POWER		7
+#define SIM_IDLE			8		// ignoring everything until the next reset
+
+// commands
+
+#define CMD_SEARCH			0xF0
+#define CMD_ALARM_SEARCH	0xEC
+#define CMD_MATCH			0x55
+#define CMD_SKIP			0xCC
+#define CMD_CONVERT			0x44
+#define CMD_COPY			0x48
+#define CMD_READ_SCRATCH	0xBE
+#define CMD_WRITE_SCRATCH	0x4E
+#define CMD_RECALL			0xB8
+#define CMD_READ_POWER		0xB4
+
+#define DS18S20MODEL 		0x10
+
+
+myOneWireSim::myOneWireSim(uint32_t seed/*=1*/) :
+	m_num_devices(0),
+	m_rand(seed ? seed : 1),
+	m_state(SIM_IDLE),
+	m_count(0),
+	m_search_second(0),
+	m_power(0)
+{
+	resetStats();
+	reset_search();
+}
+
+
+void myOneWireSim::resetStats()
+{
+	m_bus_us = 0;
+	m_resets = 0;
+	m_bytes_out = 0;
+	m_bytes_in = 0;
+	m_bits = 0;
+}
+
+
+float myOneWireSim::random()
+	// xorshift32, 0..1
+{
+	m_rand ^= m_rand << 13;
+	m_rand ^= m_rand >> 17;
+	m_rand ^= m_rand << 5;
+	return (m_rand & 0xffffff) / (float) 0x1000000;
+}
+
+
+void myOneWireSim::advance(uint32_t us)
+{
+	m_bus_us += us;
+	hostAdvanceMicros(us);
+}
+
+
+int myOneWireSim::addDevice(uint8_t family, float base_c, float amplitude_c/*=0*/, float period_s/*=60*/)
+{
+	if (m_num_devices >= SIM_MAX_DEVICES)
+		return -1;
+	simDevice_t *dev = &m_devices[m_num_devices];
+	memset(dev,0,sizeof(simDevice_t));
+
+	dev->rom[0] = family;
+	for (int i=1; i<7; i++)
+		dev->rom[i] = random() * 256;
+	dev->rom[7] = crc8(dev->rom,7);
+
+	dev->base_c = base_c;
+	dev->amplitude_c = amplitude_c;
+	dev->period_s = period_s;
+
+	// power on state: 85C, TH=75, TL=70, 12 bits
+
+	dev->eeprom[0] = 75;
+	dev->eeprom[1] = 70;
+	dev->eeprom[2] = 0x7F;
+	dev->scratch[0] = 0x50;
+	dev->scratch[1] = 0x05;
+	dev->scratch[2] = dev->eeprom[0];
+	dev->scratch[3] = dev->eeprom[1];
+	dev->scratch[4] = family == DS18S20MODEL ? 0xFF : dev->eeprom[2];
+	dev->scratch[5] = 0xFF;
+	dev->scratch[6] = 0x0C;
+	dev->scratch[7] = 0x10;
+	dev->scratch[8] = crc8(dev->scratch,8);
+
+	return m_num_devices++;
+}
+
+
+void myOneWireSim::setBadRom(int index)
+{
+	m_devices[index].rom[7] ^= 0x5A;
+}
+
+
+float myOneWireSim::temperatureAt(int index, uint32_t us)
+{
+	simDevice_t *dev = &m_devices[index];
+	if (!dev->amplitude_c || !dev->period_s)
+		return dev->base_c;
+	return dev->base_c + dev->amplitude_c *
+		sin(2 * M_PI * (us / 1000000.0) / dev->period_s);
+}
+
+
+int myOneWireSim::resolution(simDevice_t *dev)
+{
+	if (dev->rom[0] == DS18S20MODEL)
+		return 12;
+	return 9 + ((dev->scratch[4] >> 5) & 3);
+}
+
+
+//-----------------------------------
+// device behavior
+//-----------------------------------
+
+void myOneWireSim::convert(simDevice_t *dev)
+{
+	int index = dev - m_devices;
+	float temp = temperatureAt(index,micros());
+	int res = resolution(dev);
+
+	if (dev->rom[0] == DS18S20MODEL)
+	{
+		// 9 bit half degrees, with the COUNT_REMAIN extension
+
+		int half = (int) floor(temp * 2);
+		int16_t raw = half;
+		float temp_read = (half & ~1) / 2.0f;
+		int remain = 16 - (int) lround((temp - temp_read + 0.25f) * 16);
+		if (remain < 0) remain = 0;
+		if (remain > 16) remain = 16;
+		dev->scratch[0] = raw & 0xff;
+		dev->scratch[1] = (raw >> 8) & 0xff;
+		dev->scratch[6] = remain;
+		dev->scratch[7] = 16;
+	}
+	else
+	{
+		int16_t raw = (int16_t) lround(temp * 16);
+		raw &= ~((1 << (12 - res)) - 1);
+		dev->scratch[0] = raw & 0xff;
+		dev->scratch[1] = (raw >> 8) & 0xff;
+	}
+	dev->scratch[8] = crc8(dev->scratch,8);
+
+	int whole = (int) floor(temp);
+	dev->alarm =
+		whole >= (int8_t) dev->scratch[2] ||
+		whole <= (int8_t) dev->scratch[3];
+
+	uint32_t conv_us = dev->rom[0] == DS18S20MODEL ? 750000 : 93750 << (res - 9);
+	dev->convert_done = micros() + conv_us;
+}
+
+
+void myOneWireSim::prepareRead(simDevice_t *dev)
+	// what the master will see, with any faults
+{
+	memcpy(dev->out,dev->scratch,9);
+	if (dev->p_zero && random() < dev->p_zero)
+		memset(dev->out,0,9);
+	else if (dev->p_crc && random() < dev->p_crc)
+		dev->out[(int) (random() * 8)] ^= 1 << (int) (random() * 8);
+}
+
+
+void myOneWireSim::functionCommand(uint8_t cmd)
+{
+	m_count = 0;
+	switch (cmd)
+	{
+		case CMD_CONVERT:
+			for (int i=0; i<m_num_devices; i++)
+				if (m_devices[i].selected &&
+					(m_power || !m_devices[i].parasite))
+					convert(&m_devices[i]);
+			m_state = SIM_CONVERTING;
+			break;
+
+		case CMD_READ_SCRATCH:
+			for (int i=0; i<m_num_devices; i++)
+				if (m_devices[i].selected)
+					prepareRead(&m_devices[i]);
+			m_state = SIM_READ_SCRATCH;
+			break;
+
+		case CMD_WRITE_SCRATCH:
+			m_state = SIM_WRITE_SCRATCH;
+			break;
+
+		case CMD_COPY:
+		case CMD_RECALL:
+			for (int i=0; i<m_num_devices; i++)
+			{
+				simDevice_t *dev = &m_devices[i];
+				if (!dev->selected)
+					continue;
+				if (cmd == CMD_COPY)
+					memcpy(dev->eeprom,&dev->scratch[2],3);
+				else
+					memcpy(&dev->scratch[2],dev->eeprom,3);
+				dev->scratch[8] = crc8(dev->scratch,8);
+			}
+			m_state = SIM_IDLE;
+			break;
+
+		case CMD_READ_POWER:
+			m_state = SIM_READ_POWER;
+			break;
+
+		default:
+			m_state = SIM_IDLE;
+	}
+}
+
+
+//-----------------------------------
+// myOneWire
+//-----------------------------------
+
+uint8_t myOneWireSim::reset()
+{
+	advance(SIM_RESET_US);
+	m_resets++;
+	m_state = SIM_ROM_CMD;
+	m_count = 0;
+
+	bool any = false;
+	for (int i=0; i<m_num_devices; i++)
+	{
+		simDevice_t *dev = &m_devices[i];
+		dev->present = !(dev->p_dropout && random() < dev->p_dropout);
+		dev->selected = false;
+		any |= dev->present;
+	}
+	return any;
+}
+
+
+void myOneWireSim::select(const uint8_t *rom)
+{
+	write(CMD_MATCH);
+	for (int i=0; i<8; i++)
+		write(rom[i]);
+}
+
+
+void myOneWireSim::skip()
+{
+	write(CMD_SKIP);
+}
+
+
+void myOneWireSim::write(uint8_t v, uint8_t power/*=0*/)
+{
+	advance(8 * SIM_SLOT_US);
+	m_bytes_out++;
+	m_power = power;
+
+	switch (m_state)
+	{
+		case SIM_ROM_CMD:
+			m_count = 0;
+			if (v == CMD_SKIP)
+			{
+				for (int i=0; i<m_num_devices; i++)
+					m_devices[i].selected = m_devices[i].present;
+				m_state = SIM_FUNCTION;
+			}
+			else if (v == CMD_MATCH)
+			{
+				for (int i=0; i<m_num_devices; i++)
+					m_devices[i].selected = m_devices[i].present;
+				m_state = SIM_MATCH;
+			}
+			else if (v == CMD_SEARCH || v == CMD_ALARM_SEARCH)
+			{
+				for (int i=0; i<m_num_devices; i++)
+					m_devices[i].selected = m_devices[i].present &&
+						(v == CMD_SEARCH || m_devices[i].alarm);
+				m_search_second = 0;
+				m_state = SIM_SEARCH;
+			}
+			else
+				m_state = SIM_IDLE;
+			break;
+
+		case SIM_MATCH:
+			for (int i=0; i<m_num_devices; i++)
+				if (m_devices[i].rom[m_count] != v)
+					m_devices[i].selected = false;
+			if (++m_count == 8)
+				m_state = SIM_FUNCTION;
+			break;
+
+		case SIM_FUNCTION:
+			functionCommand(v);
+			break;
+
+		case SIM_WRITE_SCRATCH:
+			// TH, TL, and config (except DS18S20)
+			for (int i=0; i<m_num_devices; i++)
+			{
+				simDevice_t *dev = &m_devices[i];
+				if (!dev->selected)
+					continue;
+				if (m_count == 2)
+				{
+					if (dev->rom[0] != DS18S20MODEL)
+						dev->scratch[4] = (v & 0x60) | 0x1F;
+				}
+				else if (m_count < 2)
+					dev->scratch[2 + m_count] = v;
+				dev->scratch[8] = crc8(dev->scratch,8);
+			}
+			if (++m_count == 3)
+				m_state = SIM_IDLE;
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+uint8_t myOneWireSim::read()
+	// wired AND of the selected devices
+{
+	advance(8 * SIM_SLOT_US);
+	m_bytes_in++;
+
+	uint8_t rslt = 0xff;
+	if (m_state == SIM_READ_SCRATCH)
+	{
+		if (m_count < 9)
+		{
+			for (int i=0; i<m_num_devices; i++)
+				if (m_devices[i].selected)
+					rslt &= m_devices[i].out[m_count];
+		}
+		m_count++;
+	}
+	return rslt;
+}
+
+
+void myOneWireSim::write_bit(uint8_t v)
+{
+	advance(SIM_SLOT_US);
+	m_bits++;
+
+	if (m_state == SIM_SEARCH)
+	{
+		for (int i=0; i<m_num_devices; i++)
+			if (m_devices[i].selected && romBit(&m_devices[i],m_count) != (v & 1))
+				m_devices[i].selected = false;
+		m_search_second = 0;
+		if (++m_count == 64)
+			m_state = SIM_IDLE;
+	}
+}
+
+
+uint8_t myOneWireSim::read_bit()
+{
+	advance(SIM_SLOT_US);
+	m_bits++;
+
+	uint8_t rslt = 1;
+	switch (m_state)
+	{
+		case SIM_SEARCH:
+			// the bit, then its complement, from every participant
+			for (int i=0; i<m_num_devices; i++)
+			{
+				if (m_devices[i].selected)
+				{
+					bool bit = romBit(&m_devices[i],m_count);
+					if (m_search_second ? !bit : bit)
+						continue;
+					rslt = 0;
+				}
+			}
+			m_search_second = !m_search_second;
+			break;
+
+		case SIM_CONVERTING:
+			// parasite devices cannot pull the bus low
+			for (int i=0; i<m_num_devices; i++)
+			{
+				simDevice_t *dev = &m_devices[i];
+				if (dev->selected && !dev->parasite && (int32_t) (micros() - dev->convert_done) < 0)
+					rslt = 0;
+			}
+			break;
+
+		case SIM_READ_POWER:
+			for (int i=0; i<m_num_devices; i++)
+				if (m_devices[i].selected && m_devices[i].parasite)
+					rslt = 0;
+			break;
+	}
+	return rslt;
+}
+
+
+void myOneWireSim::reset_search()
+{
+	m_last_discrepancy = 0;
+	m_last_device = false;
+	memset(m_search_rom,0,8);
+}
+
+
+bool myOneWireSim::search(uint8_t *addr, bool search_mode/*=true*/)
+	// the standard Maxim (AN187) algorithm, as in the OneWire library
+{
+	if (m_last_device)
+	{
+		reset_search();
+		return false;
+	}
+	if (!reset())
+	{
+		reset_search();
+		return false;
+	}
+
+	write(search_mode ? CMD_SEARCH : CMD_ALARM_SEARCH);
+
+	int last_zero = 0;
+	for (int bit=0; bit<64; bit++)
+	{
+		uint8_t id_bit = read_bit();
+		uint8_t cmp_id_bit = read_bit();
+		if (id_bit && cmp_id_bit)
+		{
+			reset_search();
+			return false;		// no devices participating
+		}
+
+		uint8_t mask = 1 << (bit % 8);
+		uint8_t *byte = &m_search_rom[bit / 8];
+		bool dir;
+		if (id_bit != cmp_id_bit)
+			dir = id_bit;
+		else
+		{
+			if (bit + 1 < m_last_discrepancy)
+				dir = (*byte & mask) != 0;
+			else
+				dir = bit + 1 == m_last_discrepancy;
+			if (!dir)
+				last_zero = bit + 1;
+		}
+
+		if (dir)
+			*byte |= mask;
+		else
+			*byte &= ~mask;
+		write_bit(dir);
+	}
+
+	m_last_discrepancy = last_zero;
+	if (!m_last_discrepancy)
+		m_last_device = true;
+	memcpy(addr,m_search_rom,8);
+	return true;
+}
@@ -0,0 +1,129 @@
+//---------------------------------------------
+// myOneWireSim.h
+//---------------------------------------------
+// A simulated OneWire bus with virtual DS18x20 family devices,
+// for testing and benchmarking myTempSensor on a Linux host.
+//
+// The simulator works at the level of the myOneWire calls,
+// tracking the ROM and function commands the way the devices
+// would, including the bit level ROM search and alarm search,
+// conversion times by resolution, the scratch pad and EEPROM,
+// and READPOWERSUPPLY. A parasite powered device only converts
+// if STARTCONVO is written with power, for the strong pullup,
+// and otherwise keeps the value it had, 85C after power on.
+//
+// Every call adds its standard speed duration to the bus time,
+// and advances the host virtual clock (hostSetVirtualTime(true))
+// by the same amount. The devices take their time from micros(),
+// so that pending() and conversion times play out in simulated
+// time, which the caller also advances while the bus is idle.
+//
+// Faults may be injected per device, as probabilities per
+// transaction: corrupted scratch pads (CRC errors), dropouts
+// (no presence, reads as all ones), and all zero scratch pads.
+// A device may also be given a bad ROM CRC.
+
+#pragma once
+
+#include <myOneWire.h>
+
+#define SIM_MAX_DEVICES		64
+
+#define SIM_RESET_US		960		// reset pulse plus presence
+#define SIM_SLOT_US			70		// one bit time slot
+
+
+typedef struct
+{
+	uint8_t rom[8];
+	uint8_t scratch[9];
+	uint8_t eeprom[3];			// TH, TL, config
+	bool parasite;
+
+	// temperature curve: base + amplitude * sin(2 pi t / period)
+
+	float base_c;
+	float amplitude_c;
+	float period_s;
+
+	// faults
+
+	float p_crc;				// corrupt a scratch pad byte
+	float p_dropout;			// do not answer this transaction
+	float p_zero;				// return an all zero scratch pad
+
+	// internal state
+
+	bool present;				// for this transaction
+	bool selected;
+	bool alarm;
+	uint32_t convert_done;		// micros() when the conversion completes
+	uint8_t out[9];				// scratch pad as it will be read
+} simDevice_t;
+
+
+class myOneWireSim : public myOneWire
+{
+public:
+
+	myOneWireSim(uint32_t seed=1);
+
+	int addDevice(uint8_t family, float base_c, float amplitude_c=0, float period_s=60);
+		// returns the index of the new device, with a pseudo random ROM
+		// and 12 bit resolution, or -1 if full
+	simDevice_t *getDevice(int index)  { return &m_devices[index]; }
+	int getNumDevices()  { return m_num_devices; }
+	void setBadRom(int index);
+		// corrupts the ROM CRC of the device
+
+	float temperatureAt(int index, uint32_t us);
+
+	// statistics
+
+	uint64_t m_bus_us;			// time spent on the bus
+	uint32_t m_resets;
+	uint32_t m_bytes_out;
+	uint32_t m_bytes_in;
+	uint32_t m_bits;			// single bit slots (search, polling)
+	void resetStats();
+
+	// myOneWire
+
+	uint8_t reset() override;
+	void select(const uint8_t *rom) override;
+	void skip() override;
+	void write(uint8_t v, uint8_t power=0) override;
+	uint8_t read() override;
+	void write_bit(uint8_t v) override;
+	uint8_t read_bit() override;
+	void depower() override {}
+	void reset_search() override;
+	bool search(uint8_t *addr, bool search_mode=true) override;
+
+private:
+
+	int m_num_devices;
+	simDevice_t m_devices[SIM_MAX_DEVICES];
+
+	uint32_t m_rand;
+
+	int m_state;
+	int m_count;				// bytes or bits into the current state
+	bool m_search_second;		// second read of a search triplet
+	bool m_power;				// of the byte being written
+
+	// search state as in the OneWire library
+
+	uint8_t m_search_rom[8];
+	int m_last_discrepancy;
+	bool m_last_device;
+
+	float random();
+	void advance(uint32_t us);
+	void functionCommand(uint8_t cmd);
+	void convert(simDevice_t *dev);
+	void prepareRead(simDevice_t *dev);
+	int resolution(simDevice_t *dev);
+	bool romBit(simDevice_t *dev, int bit)  { return (dev->rom[bit / 8] >> (bit % 8)) & 1; }
+
+};
@@ -0,0 +1,473 @@
+//--------------------------------------------------------
+// tsenseBench.cpp
+//--------------------------------------------------------
+// Host test and benchmark of myTempSensor against the
+// simulated OneWire bus, in virtual time.
+//
+// For each configuration, runs a number of sweeps with the
+// loop() engine, and reports the bus time per sweep, the
+// time from the start of a sweep to the last result, the
+// bytes and single bit slots (polling) per sweep, the error
+// counts, and the worst error against the simulated temperature
+// at the time the result is seen, which includes the change
+// since the conversion.
+//
+// Then compares normal and alarm sweeps of a bus where most of
+// the devices stay within their alarm thresholds.
+//
+// Then compares the time to sweep the same devices spread over
+// several buses, one bus after another, or together with a
+// myTempSensorGroup. The reads are still serial, as the buses
+// share one cpu, but the group overlaps the conversions.
+//
+// Then does a blocking readAll() of a small bus, and sweeps a
+// device sitting at -0.0625C, whose fast reads are all ones, as
+// those of a device that did not answer are, to show that it is
+// read in full without being held against the device.
+//
+// Finally unplugs, replugs and adds devices while sweeping with
+// setRescan(), and shows the hot-plug events and the longest
+// single loop() step on the bus, and the myTempHistory rollups
+// of a device over a few minutes.
+//
+// Build on Linux:
+//
+//		g++ -O2 -I../host -I../.. tsenseBench.cpp myOneWireSim.cpp
+//			../../myTempSensor.cpp ../../myTempHistory.cpp ../../myOneWire.cpp
+//			../host/hostShim.cpp
+//			-o tsenseBench
+
+#include "myOneWireSim.h"
+#include <myTempSensor.h>
+#include <stdio.h>
+#include <math.h>
+
+#define NUM_DEVICES		8
+#define NUM_SWEEPS		200
+#define IDLE_US			500			// virtual time per idle loop()
+
+
+typedef struct
+{
+	const char *name;
+	int read_mode;
+	int bits;
+	bool poll;
+	bool faults;
+	bool parasite;
+	bool mixed;				// with a 750ms DS18S20
+} benchConfig_t;
+
+
+static const benchConfig_t configs[] =
+{
+	{ "full 12 bits",			TSENSE_READ_FULL,		12,	0, 0, 0, 0 },
+	{ "full 12 polled",			TSENSE_READ_FULL,		12,	1, 0, 0, 0 },
+	{ "fast 12 polled",			TSENSE_READ_FAST,		12,	1, 0, 0, 0 },
+	{ "adaptive 12 polled",		TSENSE_READ_ADAPTIVE,	12,	1, 0, 0, 0 },
+	{ "adaptive 9 polled",		TSENSE_READ_ADAPTIVE,	9,	1, 0, 0, 0 },
+	{ "adaptive 9 mixed",		TSENSE_READ_ADAPTIVE,	9,	1, 0, 0, 1 },
+	{ "adaptive 12 parasite",	TSENSE_READ_ADAPTIVE,	12,	1, 0, 1, 0 },
+	{ "full 12 faults",			TSENSE_READ_FULL,		12,	1, 1, 0, 1 },
+	{ "adaptive 12 faults",		TSENSE_READ_ADAPTIVE,	12,	1, 1, 0, 1 },
+};
+
+
+static void runConfig(const benchConfig_t *cfg)
+{
+	static const uint8_t families[] = { 0x28, 0x28, 0x28, 0x22, 0x3B, 0x42, 0x28, 0x28 };
+
+	myOneWireSim sim(12345);
+	for (int i=0; i<NUM_DEVICES; i++)
+	{
+		uint8_t family = cfg->mixed && i == NUM_DEVICES-1 ? 0x10 : families[i];
+		int index = sim.addDevice(family,20 + i * 3,2 + i,30 + i * 10);
+		simDevice_t *dev = sim.getDevice(index);
+		dev->parasite = cfg->parasite && (i & 1);
+		if (cfg->faults)
+		{
+			dev->p_crc = 0.02;
+			dev->p_dropout = i == 3 ? 0.05 : 0;
+			dev->p_zero = i == 5 ? 0.02 : 0;
+		}
+	}
+	if (cfg->faults)
+	{
+		int index = sim.addDevice(0x28,0);
+		sim.setBadRom(index);
+	}
+
+	myTempSensor sensor(&sim);
+	sensor.init();
+
+	// setResolution() needs the init() measurement to finish
+
+	while (sensor.pending())
+		hostAdvanceMicros(IDLE_US);
+	sensor.setResolution(-1,cfg->bits);
+	sensor.setReadMode(cfg->read_mode);
+	sensor.setPollReady(cfg->poll);
+
+	sim.resetStats();
+	uint32_t start_us = micros();
+	uint32_t errors = 0;
+	uint32_t reads = 0;
+	float worst = 0;
+	uint32_t last_time[MAX_TSENSE_DEVICES] = {0};
+
+	sensor.startSweeps(0);
+	while (sensor.getSweepCount() < NUM_SWEEPS)
+	{
+		if (!sensor.loop())
+			hostAdvanceMicros(IDLE_US);
+
+		for (int i=0; i<sensor.getNumDevices(); i++)
+		{
+			int16_t raw;
+			uint8_t status;
+			uint32_t time;
+			if (!sensor.getSnapshot(i,&raw,&status,&time) ||
+				time == last_time[i])
+				continue;
+			last_time[i] = time;
+			reads++;
+			if (status)
+			{
+				errors++;
+				continue;
+			}
+
+			// the value was converted at the start of the sweep,
+			// so allow for the change since then
+
+			int index = -1;
+			const tsenseDevice_t *dev = sensor.getDevice(i);
+			for (int j=0; j<sim.getNumDevices(); j++)
+				if (!memcmp(sim.getDevice(j)->rom,dev->addr,8))
+					index = j;
+			float err = fabs(raw / 128.0f - sim.temperatureAt(index,micros()));
+			if (err > worst)
+				worst = err;
+		}
+	}
+	sensor.stopSweeps();
+
+	uint32_t elapsed = micros() - start_us;
+	printf("%-22s %3d  %7.1f %7.1f %6u %6u %6u  %6u %6.2f\n",
+		cfg->name,
+		sensor.getNumDevices(),
+		sim.m_bus_us / 1000.0 / NUM_SWEEPS,
+		elapsed / 1000.0 / NUM_SWEEPS,
+		sim.m_resets / NUM_SWEEPS,
+		(sim.m_bytes_out + sim.m_bytes_in) / NUM_SWEEPS,
+		sim.m_bits / NUM_SWEEPS,
+		errors,
+		worst);
+}
+
+
+static void runAlarms(bool alarm_sweeps)
+{
+	myOneWireSim sim(31337);
+	for (int i=0; i<16; i++)
+	{
+		// two of them swing out of their band
+		bool swing = i == 3 || i == 11;
+		sim.addDevice(0x28,15 + i,swing ? 6 : 0.3,swing ? 40 : 90);
+	}
+
+	myTempSensor sensor(&sim);
+	sensor.init();
+	while (sensor.pending())
+		hostAdvanceMicros(IDLE_US);
+	sensor.setReadMode(TSENSE_READ_ADAPTIVE);
+	for (int i=0; i<sensor.getNumDevices(); i++)
+	{
+		int base = sensor.getDegreesC(i);
+		sensor.setAlarms(i,base + 2,base - 2);
+	}
+	sensor.setAlarmSweeps(alarm_sweeps);
+
+	sim.resetStats();
+	uint32_t start_us = micros();
+	uint32_t reads = 0;
+	uint32_t last_time[MAX_TSENSE_DEVICES] = {0};
+	sensor.startSweeps(0);
+	while (sensor.getSweepCount() < NUM_SWEEPS)
+	{
+		if (!sensor.loop())
+			hostAdvanceMicros(IDLE_US);
+		for (int i=0; i<sensor.getNumDevices(); i++)
+		{
+			int16_t raw;
+			uint32_t time;
+			if (sensor.getSnapshot(i,&raw,NULL,&time) && time != last_time[i])
+			{
+				last_time[i] = time;
+				reads++;
+			}
+		}
+	}
+	sensor.stopSweeps();
+
+	printf("%-22s %3d  %7.1f %7.1f %6.1f\n",
+		alarm_sweeps ? "alarm sweeps" : "normal sweeps",
+		sensor.getNumDevices(),
+		sim.m_bus_us / 1000.0 / NUM_SWEEPS,
+		(micros() - start_us) / 1000.0 / NUM_SWEEPS,
+		(float) reads / NUM_SWEEPS);
+}
+
+
+static void runGroup(int num_buses, int per_bus)
+{
+	myOneWireSim *sims[TSENSE_MAX_BUSES];
+	myTempSensor *sensors[TSENSE_MAX_BUSES];
+	myTempSensorGroup group;
+
+	for (int b=0; b<num_buses; b++)
+	{
+		sims[b] = new myOneWireSim(100 + b);
+		for (int i=0; i<per_bus; i++)
+			sims[b]->addDevice(0x28,20 + i,1,60);
+		sensors[b] = new myTempSensor(sims[b]);
+		sensors[b]->init();
+		while (sensors[b]->pending())
+			hostAdvanceMicros(IDLE_US);
+		sensors[b]->setResolution(-1,12);
+		sensors[b]->setReadMode(TSENSE_READ_ADAPTIVE);
+		group.add(sensors[b]);
+	}
+
+	uint32_t start_us = micros();
+	for (int n=0; n<NUM_SWEEPS; n++)
+	{
+		for (int b=0; b<num_buses; b++)
+		{
+			sensors[b]->sweepOnce();
+			while (sensors[b]->sweepBusy())
+				if (!sensors[b]->loop())
+					hostAdvanceMicros(IDLE_US);
+		}
+	}
+	uint32_t serial = micros() - start_us;
+
+	start_us = micros();
+	group.startSweeps(0);
+	while (group.getSweepCount() < NUM_SWEEPS)
+		if (!group.loop())
+			hostAdvanceMicros(IDLE_US);
+	group.stopSweeps();
+	uint32_t together = micros() - start_us;
+
+	printf("%d bus%s of %2d devices   %7.1f %7.1f\n",
+		num_buses,num_buses > 1 ? "es" : "  ",per_bus,
+		serial / 1000.0 / NUM_SWEEPS,
+		together / 1000.0 / NUM_SWEEPS);
+
+	for (int b=0; b<num_buses; b++)
+	{
+		delete sensors[b];
+		delete sims[b];
+	}
+}
+
+
+static void showEvents(myTempSensor *sensor, const char *what)
+{
+	tsenseEvent_t event;
+	printf("%-26s",what);
+	while (sensor->getEvent(&event))
+		printf(" %s(%d)",event.type == TSENSE_EVENT_ARRIVED ? "arrived" : "departed",event.handle);
+	printf("\n");
+}
+
+
+static void runReadAll()
+{
+	myOneWireSim sim(99);
+	for (int i=0; i<4; i++)
+		sim.addDevice(0x28,-10.5 + i * 12.25);
+	sim.getDevice(2)->p_crc = 1;
+
+	myTempSensor sensor(&sim);
+	sensor.init();
+	while (sensor.pending())
+		hostAdvanceMicros(IDLE_US);
+
+	int16_t raw[MAX_TSENSE_DEVICES];
+	uint8_t status[MAX_TSENSE_DEVICES];
+	int n = sensor.readAll(raw,status,MAX_TSENSE_DEVICES);
+	for (int i=0; i<n; i++)
+		printf("%d: raw(%d) %.4fC status(%d,%s)\n",
+			i,raw[i],raw[i] / 128.0,status[i],myTempSensor::errString(status[i]));
+}
+
+
+static void runHotPlug()
+{
+	myOneWireSim sim(777);
+	for (int i=0; i<6; i++)
+		sim.addDevice(0x28,20 + i);
+
+	myTempSensor sensor(&sim);
+	sensor.init();
+	sensor.setReadMode(TSENSE_READ_ADAPTIVE);
+	sensor.setRescan(2000);
+	sensor.startSweeps(0);
+
+	uint64_t max_step = 0;
+	auto run = [&](uint32_t ms)
+	{
+		uint32_t start = millis();
+		while (millis() - start < ms)
+		{
+			uint64_t before = sim.m_bus_us;
+			if (!sensor.loop())
+				hostAdvanceMicros(IDLE_US);
+			if (sim.m_bus_us - before > max_step)
+				max_step = sim.m_bus_us - before;
+		}
+	};
+
+	run(3000);
+	showEvents(&sensor,"steady");
+	sim.getDevice(2)->p_dropout = 1;
+	sim.getDevice(4)->p_dropout = 1;
+	run(3000);
+	showEvents(&sensor,"unplug two");
+	sim.getDevice(2)->p_dropout = 0;
+	run(3000);
+	showEvents(&sensor,"replug one");
+	sim.addDevice(0x28,30);
+	sim.addDevice(0x22,31);
+	run(3000);
+	showEvents(&sensor,"add two");
+
+	printf("\n%d devices, %u sweeps, %u re-scans, longest step %.2f ms\n",
+		sensor.getNumDevices(),
+		sensor.getSweepCount(),
+		sensor.getRescanCount(),
+		max_step / 1000.0);
+}
+
+
+static void runHistory()
+{
+	myOneWireSim sim(4242);
+	sim.addDevice(0x28,20,5,120);
+
+	myTempSensor sensor(&sim);
+	sensor.init();
+	sensor.startSweeps(1000);
+
+	uint32_t start = millis();
+	while (millis() - start < 5 * 60000)
+		if (!sensor.loop())
+			hostAdvanceMicros(IDLE_US);
+
+	const myTempHistory *history = sensor.getHistory(0);
+	int16_t samples[8];
+	int n = history->getSamples(samples,8);
+	printf("last %d samples:",n);
+	for (int i=0; i<n; i++)
+		printf(" %.2f",samples[i] / 128.0);
+	printf("\n\n");
+
+	for (int level=0; level<TSENSE_ROLLUP_LEVELS; level++)
+	{
+		for (int back=0; back<=3; back++)
+		{
+			tsenseRollup_t r;
+			if (!history->getRollup(level,back,&r))
+				continue;
+			printf("%7ums back(%d) at %6u  min %6.2f  max %6.2f  mean %6.2f  count %u\n",
+				myTempHistory::getPeriod(level),back,r.time,
+				r.min / 128.0,r.max / 128.0,r.mean / 128.0,r.count);
+		}
+	}
+}
+static void runAllOnes()
+{
+	myOneWireSim sim(7);
+	sim.addDevice(0x28,-0.0625);
+	sim.addDevice(0x28,4.0);
+
+	myTempSensor sensor(&sim);
+	sensor.init();
+	while (sensor.pending())
+		hostAdvanceMicros(IDLE_US);
+	sensor.setReadMode(TSENSE_READ_ADAPTIVE);
+	sensor.setPollReady(1);
+
+	uint32_t errors = 0;
+	uint32_t last_time[2] = {0};
+	sensor.startSweeps(0);
+	while (sensor.getSweepCount() < 50)
+	{
+		if (!sensor.loop())
+			hostAdvanceMicros(IDLE_US);
+		for (int i=0; i<2; i++)
+		{
+			int16_t raw;
+			uint8_t status;
+			uint32_t time;
+			if (sensor.getSnapshot(i,&raw,&status,&time) &&
+				time != last_time[i])
+			{
+				last_time[i] = time;
+				if (status)
+					errors++;
+			}
+		}
+	}
+	sensor.stopSweeps();
+
+	for (int i=0; i<2; i++)
+	{
+		const tsenseDevice_t *dev = sensor.getDevice(i);
+		printf("%d: raw(%d) %.4fC status(%s) err_score(%d) full_reads(%d)\n",
+			i,dev->raw,dev->raw / 128.0,myTempSensor::errString(dev->status),
+			dev->err_score,dev->full_reads);
+	}
+	printf("errors(%u) in 50 sweeps\n",errors);
+}
+
+
+
+int main(int argc, char **argv)
+{
+	hostSetVirtualTime(true);
+
+	printf("myTempSensor on the simulated bus, %d sweeps per configuration\n\n",NUM_SWEEPS);
+	printf("%-22s %3s  %7s %7s %6s %6s %6s  %6s %6s\n",
+		"config","dev","bus_ms","sweep","resets","bytes","bits","errors","worst");
+
+	for (unsigned i=0; i<sizeof(configs)/sizeof(configs[0]); i++)
+		runConfig(&configs[i]);
+
+	printf("\nalarm sweeps, 2 of 16 devices leaving their band\n\n");
+	printf("%-22s %3s  %7s %7s %6s\n","config","dev","bus_ms","sweep","reads");
+	runAlarms(false);
+	runAlarms(true);
+
+	printf("\nms per sweep of all buses, adaptive 12 bits polled\n\n");
+	printf("%-22s   %7s %7s\n","","serial","group");
+	runGroup(1,16);
+	runGroup(2,8);
+	runGroup(4,4);
+
+	printf("\nreadAll() with a corrupted device\n\n");
+	runReadAll();
+
+	printf("\nadaptive sweeps of a device at -0.0625C\n\n");
+	runAllOnes();
+
+	printf("\nhot-plug, re-scan every 2 seconds\n\n");
+	runHotPlug();
+
+	printf("\nhistory of a device swept every second for 5 minutes\n\n");
+	runHistory();
+
+	return 0;
+}
@@ -6,6 +6,21 @@
 // two different ino (preference.txt) files for building.
 //
 // Note that we use 250KBPS bus for compatability with NMEA2000.
+//
+// myCANDriver.h provides an interrupt driven receive path,
+// and a priority transmit queue, over a myCANBackend, which is
+// myCANMcp2515.h for HOW_BUS_MPC2515, or myCANMcpCan.h for
+// HOW_BUS_CANBUS.
+// myCANFastPacket.h reassembles, and segments, NMEA2000
+// fast-packet PGNs.
+// myCANCapture.h records the traffic, through canBus()->setCapture(),
+// into a binary stream for extras/canCapture to turn into candump
+// or ASC logs.
+// myCANTemp.h publishes the sensors' readings on MY_TEMPERATURE_CANID,
+// three to a frame, only as they change, with acks on CAN_ACK_ID
+// if WITH_ACK.
+
+#pragma once
 
 #include <myDebug.h>
 #include <SPI.h>
@@ -32,71 +47,71 @@
 
 
 
-#if USE_HSPI
-	SPIClass hspi(HSPI);
-		// MOSI=13
-		// MISO=12
-		// SCLK=14
-		// default CS = 15
+// There are no globals for the chip. The backend owns the library's
+// object, and canBus() returns the driver, built on first use, and
+// templated on the backend so that its calls are direct. canSPI()
+// and canBus() are inline, so there is one of each in the program
+// however many files include this.
+
+#ifndef CAN_INT_PIN
+	#define CAN_INT_PIN		-1		// poll() from loop() without it
 #endif
 
+// the temperature publisher's ids, the same on either backend
 
+#define WITH_ACK  					0
+#define dbg_ack						1		// only used if WITH_ACK
+#define CAN_ACK_ID 					0x037
+#define MY_TEMPERATURE_CANID		0x036
 
-#if HOW_CAN_BUS == HOW_BUS_MPC2515
 
-	#include <mcp2515.h>
-
-	#define WITH_ACK  					0
-	#define dbg_ack						1		// only used if WITH_ACK
-	#define CAN_ACK_ID 					0x037
-	#define MY_TEMPERATURE_CANID		0x036
+#if HOW_CAN_BUS == HOW_BUS_MPC2515
 
-	// grumble SPIClass passed into in ctor which also calls SPI.begin() if it's null,
-	// then also does a pinMode and digitalWrite() to _CS in static initialization,
-	// and finally, takes requires a PRIVATE default constant in a PUBLIC api, ffs.
+	#include "myCANMcp2515.h"
 
-	#if USE_HSPI
-		#define MCP2515_DEFAULT_SPI_CLOCK   10000000 // 10MHz
-		MCP2515 mcp2515(CAN_CS_PIN,MCP2515_DEFAULT_SPI_CLOCK,&hspi);
-	#else
-		MCP2515 mcp2515(CAN_CS_PIN);
-	#endif
+	typedef myCANMcp2515 myCANBusBackend;
 
 #elif HOW_CAN_BUS == HOW_BUS_CANBUS
 
 	#define SEND_NODE_ID	237
-	#include <mcp_can.h>
-	MCP_CAN	canbus(CAN_CS_PIN);
+	#include "myCANMcpCan.h"
+
+	typedef myCANMcpCan myCANBusBackend;
 
 #endif
 
+#include "myCANDriver.h"
+
+typedef myCANDriverT<myCANBusBackend> myCANBus;
 
 
-static void initCanBus()
+inline SPIClass *canSPI()
 {
 	#if USE_HSPI
-		hspi.begin();
-	#elif 0
-		SPI.begin();
+		static SPIClass hspi(HSPI);
+			// MOSI=13
+			// MISO=12
+			// SCLK=14
+			// default CS = 15
+		return &hspi;
+	#else
+		return &SPI;
 	#endif
+}
 
-	#if HOW_CAN_BUS == HOW_BUS_MPC2515
-
-		mcp2515.reset();
-		mcp2515.setBitrate(CAN_250KBPS, MCP_8MHZ);
-		mcp2515.setNormalMode();
-
-	#elif HOW_CAN_BUS == HOW_BUS_CANBUS
 
-		#if USE_HSPI
-			canbus.setSPI(&hspi);
-		#endif
+inline myCANBus *canBus()
+{
+	static myCANBusBackend backend(CAN_CS_PIN,canSPI());
+	static myCANBus bus(&backend,CAN_INT_PIN);
+	return &bus;
+}
 
-		byte err = canbus.begin(CAN_250KBPS, MCP_8MHz);
-		if (err != CAN_OK)
-			my_error("canbus.begin() err=%d",err);
 
-	#endif
 
+inline void initCanBus()
+{
+	canSPI()->begin();
+	if (!canBus()->begin(250000))
+		my_error("initCanBus() failed",0);
 }
-
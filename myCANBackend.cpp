@@ -0,0 +1,88 @@
+//-------------------------------------------
+// myCANBackend.cpp
+//-------------------------------------------
+
+#include "myCANBackend.h"
+#include <myDebug.h>
+
+
+//-----------------------------------
+// loopback
+//-----------------------------------
+
+myCANLoopbackBus::myCANLoopbackBus() :
+	m_num(0),
+	m_frames(0)
+{}
+
+
+bool myCANLoopbackBus::attach(myCANLoopback *node)
+{
+	for (int i=0; i<m_num; i++)
+		if (m_nodes[i] == node)
+			return true;
+	if (m_num >= CAN_LOOPBACK_NODES)
+	{
+		my_error("CAN_LOOPBACK_NODES(%d) exceeded",CAN_LOOPBACK_NODES);
+		return false;
+	}
+	m_nodes[m_num++] = node;
+	return true;
+}
+
+
+void myCANLoopbackBus::deliver(const myCANLoopback *from, const myCANFrame *frame)
+{
+	m_frames++;
+	for (int i=0; i<m_num; i++)
+		if (m_nodes[i] != from)
+			m_nodes[i]->inject(frame);
+}
+
+
+myCANLoopback::myCANLoopback(myCANLoopbackBus *bus/*=NULL*/) :
+	m_bus(bus),
+	m_tx_done(0),
+	m_overflows(0)
+{}
+
+
+bool myCANLoopback::begin(uint32_t bitrate)
+{
+	return m_bus ? m_bus->attach(this) : true;
+}
+
+
+bool myCANLoopback::inject(const myCANFrame *frame)
+{
+	if (m_rx.push(frame))
+		return true;
+	m_overflows++;
+	return false;
+}
+
+
+uint8_t myCANLoopback::getEvents()
+{
+	uint8_t events = m_rx.count() ? CAN_EVENT_RX : 0;
+	if (m_tx_done)
+	{
+		events |= CAN_EVENT_TX0;
+		m_tx_done = 0;
+	}
+	return events;
+}
+
+
+bool myCANLoopback::read(myCANFrame *frame)
+{
+	return m_rx.pop(frame,1);
+}
+
+
+void myCANLoopback::load(int slot, const myCANFrame *frame)
+{
+	if (m_bus)
+		m_bus->deliver(this,frame);
+	m_tx_done = 1;
+}
@@ -0,0 +1,123 @@
+//-------------------------------------------
+// myCANBackend.h
+//-------------------------------------------
+// The controller interface under myCANDriver, so that the same
+// driver, queues, filters, and fast-packet layer run against an
+// MCP2515 through either Arduino library (myCANMcp2515.h and
+// myCANMcpCan.h), against the in-memory loopback bus below, or
+// against Linux SocketCAN (extras/host/myCANSocket.h) on a host.
+//
+// A backend has one or more TX slots. The driver loads a frame
+// into a free slot and learns it has gone from getEvents(). A
+// backend with more than one slot ranks them by setRank(), and
+// may support abort(). Receiving is a matter of getEvents()
+// reporting CAN_EVENT_RX, and read() until it returns false.
+// The driver makes all of these calls from one task.
+
+#pragma once
+
+#include <Arduino.h>
+#include "myCANFrame.h"
+
+#define CAN_MAX_TX_SLOTS			3
+
+#define CAN_EVENT_RX				0x01	// frames waiting
+#define CAN_EVENT_TX0				0x02	// CAN_EVENT_TX0 << slot has gone
+
+#ifndef CAN_LOOPBACK_NODES
+	#define CAN_LOOPBACK_NODES		8
+#endif
+#ifndef CAN_LOOPBACK_RING_SIZE
+	#define CAN_LOOPBACK_RING_SIZE	256		// frames, must be a power of 2
+#endif
+
+class myCANFilter;
+
+
+class myCANBackend
+{
+public:
+
+	virtual ~myCANBackend() {}
+
+	virtual bool begin(uint32_t bitrate) = 0;
+		// reports an error and returns false on failure
+	virtual bool setFilters(myCANFilter *filter)  { return true; }
+		// installs the compiled filter, if the controller can,
+		// or opens it up again if NULL
+
+	virtual uint8_t getEvents() = 0;
+		// CAN_EVENT_RX, and the CAN_EVENT_TX0 bits of the slots
+		// that have gone, which are then cleared; also services
+		// any error conditions
+	virtual bool read(myCANFrame *frame) = 0;
+		// the next frame waiting, without its time, or false
+
+	virtual int getTxSlots()  { return 1; }
+	virtual void load(int slot, const myCANFrame *frame) = 0;
+		// starts sending the frame from a free slot
+	virtual void setRank(int slot, int rank)  {}
+		// 0..3, the highest goes first
+	virtual bool abort(int slot)  { return false; }
+		// returns false if the backend cannot abort
+	virtual bool aborted(int slot)  { return false; }
+		// true once an aborted slot is free without having gone
+
+	virtual uint32_t getOverflows()  { return 0; }
+		// frames lost in the controller
+	virtual void getErrorCounts(uint8_t *tec, uint8_t *rec, uint8_t *flags)
+		{ *tec = 0; *rec = 0; *flags = 0; }
+	virtual void getSpiCounts(uint32_t *transactions, uint32_t *bytes)
+		{ *transactions = 0; *bytes = 0; }
+		// chip selects, and bytes, since begin(), if on SPI
+};
+
+
+
+class myCANLoopback;
+
+class myCANLoopbackBus
+	// Connects myCANLoopback nodes in memory. Every frame loaded by
+	// one node is delivered at once to all the others. Each node's
+	// ring has a single producer, so the nodes must send from one
+	// task, as in a host test or benchmark.
+{
+public:
+
+	myCANLoopbackBus();
+
+	bool attach(myCANLoopback *node);
+	void deliver(const myCANLoopback *from, const myCANFrame *frame);
+
+	uint32_t getFrames()  { return m_frames; }
+
+private:
+
+	int m_num;
+	myCANLoopback *m_nodes[CAN_LOOPBACK_NODES];
+	uint32_t m_frames;
+};
+
+
+class myCANLoopback final : public myCANBackend
+{
+public:
+
+	myCANLoopback(myCANLoopbackBus *bus=NULL);
+
+	bool inject(const myCANFrame *frame);
+		// as if received from the bus
+
+	bool begin(uint32_t bitrate) override;
+	uint8_t getEvents() override;
+	bool read(myCANFrame *frame) override;
+	void load(int slot, const myCANFrame *frame) override;
+	uint32_t getOverflows() override  { return m_overflows; }
+
+private:
+
+	myCANLoopbackBus *m_bus;
+	myCANRing<CAN_LOOPBACK_RING_SIZE> m_rx;
+	bool m_tx_done;
+	uint32_t m_overflows;
+};
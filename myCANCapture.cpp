@@ -0,0 +1,124 @@
+//-------------------------------------------
+// myCANCapture.cpp
+//-------------------------------------------
+
+#include "myCANCapture.h"
+
+
+myCANCapture::myCANCapture() :
+	m_head(0),
+	m_tail(0),
+	m_next(0),
+	m_frames(0),
+	m_lost(0),
+	m_lost_total(0),
+	m_header(0)
+{}
+
+
+void myCANCapture::put(uint32_t *head, const uint8_t *data, int len)
+{
+	for (int i=0; i<len; i++)
+		m_buf[(*head)++ & (CAN_CAPTURE_SIZE - 1)] = data[i];
+}
+
+
+void myCANCapture::put32(uint32_t *head, uint32_t value)
+{
+	uint8_t bytes[4] = {
+		(uint8_t) value,
+		(uint8_t) (value >> 8),
+		(uint8_t) (value >> 16),
+		(uint8_t) (value >> 24) };
+	put(head,bytes,4);
+}
+
+
+bool myCANCapture::add(const myCANFrame *frame, bool tx)
+{
+	uint8_t len = frame->flags & CAN_FRAME_RTR ? 0 : frame->len > 8 ? 8 : frame->len;
+	int needed = CAN_CAPTURE_RECORD + len;
+	if (m_lost)
+		needed += CAN_CAPTURE_RECORD;
+
+	uint32_t head = m_head;
+	if (head - m_tail + needed > CAN_CAPTURE_SIZE)
+	{
+		m_lost++;
+		m_lost_total++;
+		return false;
+	}
+
+	if (m_lost)
+	{
+		put32(&head,frame->time);
+		put32(&head,m_lost);
+		uint8_t lost = CAN_CAP_LOST;
+		put(&head,&lost,1);
+		m_lost = 0;
+	}
+
+	put32(&head,frame->time);
+	put32(&head,frame->id);
+	uint8_t flags = len |
+		(frame->flags & CAN_FRAME_EXT ? CAN_CAP_EXT : 0) |
+		(frame->flags & CAN_FRAME_RTR ? CAN_CAP_RTR : 0) |
+		(tx ? CAN_CAP_TX : 0);
+	put(&head,&flags,1);
+	put(&head,frame->data,len);
+
+	__sync_synchronize();
+	m_head = head;
+	m_frames++;
+	return true;
+}
+
+
+int myCANCapture::flush(Print *out, int max/*=0*/)
+{
+	if (!m_header)
+	{
+		// drop the rest of a record the last sink took part of
+
+		__sync_synchronize();
+		m_tail = m_next;
+
+		uint8_t header[CAN_CAPTURE_HEADER] = {};
+		memcpy(header,CAN_CAPTURE_MAGIC,8);
+		header[8] = CAN_CAPTURE_VERSION;
+		if (out->write(header,CAN_CAPTURE_HEADER) != CAN_CAPTURE_HEADER)
+			return 0;
+		m_header = 1;
+	}
+
+	uint32_t tail = m_tail;
+	int avail = m_head - tail;
+	if (max && avail > max)
+		avail = max;
+	__sync_synchronize();
+
+	// the ring wraps at most once
+
+	int written = 0;
+	while (written < avail)
+	{
+		int offset = tail & (CAN_CAPTURE_SIZE - 1);
+		int len = avail - written;
+		if (len > CAN_CAPTURE_SIZE - offset)
+			len = CAN_CAPTURE_SIZE - offset;
+		int n = out->write(&m_buf[offset],len);
+		written += n;
+		tail += n;
+		if (n < len)
+			break;
+	}
+
+	// keep track of where the next whole record starts
+
+	while ((int32_t) (tail - m_next) > 0)
+		m_next += CAN_CAPTURE_RECORD + (m_buf[(m_next + 8) & (CAN_CAPTURE_SIZE - 1)] & CAN_CAP_LEN);
+
+	__sync_synchronize();
+	m_tail = tail;
+	return written;
+}
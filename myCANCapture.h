@@ -0,0 +1,97 @@
+//-------------------------------------------
+// myCANCapture.h
+//-------------------------------------------
+// Records every frame myCANDriver receives, before the software
+// filter, and sends, as it completes, into a byte ring of compact
+// binary records, which flush() batches out to any Print: Serial,
+// a telnet stream, or a File. extras/canCapture converts the
+// stream into candump -L or Vector ASC text.
+//
+//		myCANCapture capture;
+//		canBus()->setCapture(&capture);
+//
+//		loop():
+//			capture.flush(&Serial);
+//
+// add() runs in the driver's task, and costs a copy of 9 bytes
+// plus the data into the ring, and flush() runs in another, with
+// the ring between them lock-free as myCANRing is. At 250 kbps a
+// saturated bus of 8 byte extended frames is about 30KB per second
+// of records, so the sink must keep up with that, and the ring
+// hold as long as the sink may stall. Frames that do not fit are
+// counted, and a CAN_CAP_LOST record, with their number, goes into
+// the stream ahead of the next frame that does.
+//
+// The stream starts with a header, CAN_CAPTURE_MAGIC and the
+// version, on the first flush(), or the first after restart(),
+// for a new file or connection. Records are little endian:
+//
+//		uint32_t time		micros() of the frame
+//		uint32_t id			or the number of frames lost
+//		uint8_t len			with the CAN_CAP_ flags in the top bits
+//		uint8_t data[len]	none for a remote frame
+
+#pragma once
+
+#include <Arduino.h>
+#include "myCANFrame.h"
+
+#ifndef CAN_CAPTURE_SIZE
+	#define CAN_CAPTURE_SIZE		8192	// bytes, must be a power of 2
+#endif
+
+#define CAN_CAPTURE_MAGIC			"myCANcap"
+#define CAN_CAPTURE_VERSION			1
+#define CAN_CAPTURE_HEADER			12		// magic, version, 3 reserved
+#define CAN_CAPTURE_RECORD			9		// without the data
+
+#define CAN_CAP_LEN					0x0F
+#define CAN_CAP_EXT					0x10
+#define CAN_CAP_RTR					0x20
+#define CAN_CAP_TX					0x40
+#define CAN_CAP_LOST				0x80
+
+
+class myCANCapture
+{
+public:
+
+	myCANCapture();
+
+	// producer, the driver's task
+
+	bool add(const myCANFrame *frame, bool tx);
+		// returns false, and counts the frame lost, if it does not fit
+
+	// consumer
+
+	int flush(Print *out, int max=0);
+		// writes up to max bytes, or all that are waiting if 0,
+		// in at most two writes, and returns the number written
+	void restart()  { m_header = 0; }
+		// the next flush() starts a new stream with a header,
+		// after dropping what is left of a partly written record
+
+	int pending()	{ return m_head - m_tail; }
+	uint32_t getFrames()	{ return m_frames; }
+	uint32_t getLost()		{ return m_lost_total; }
+
+private:
+
+	static_assert((CAN_CAPTURE_SIZE & (CAN_CAPTURE_SIZE - 1)) == 0,
+		"CAN_CAPTURE_SIZE must be a power of 2");
+
+	volatile uint32_t m_head;	// written only by the producer
+	volatile uint32_t m_tail;	// written only by the consumer
+	uint32_t m_next;			// the consumer's next record boundary
+	uint8_t m_buf[CAN_CAPTURE_SIZE];
+
+	uint32_t m_frames;
+	uint32_t m_lost;			// not yet recorded in the stream
+	uint32_t m_lost_total;
+	bool m_header;
+
+	void put(uint32_t *head, const uint8_t *data, int len);
+	void put32(uint32_t *head, uint32_t value);
+
+};
@@ -0,0 +1,135 @@
+//-------------------------------------------
+// myCANDriver.cpp
+//-------------------------------------------
+// The parts of the driver that do not depend on the backend.
+
+#include "myCANDriver.h"
+
+
+// static
+float myCANDriverBase::busLoad(const myCANStats *prev, const myCANStats *now, uint32_t bitrate/*=250000*/)
+{
+	uint32_t us = now->time - prev->time;
+	if (!us || !bitrate)
+		return 0;
+	uint32_t bits =
+		(now->rx_bits - prev->rx_bits) +
+		(now->tx_bits - prev->tx_bits);
+	return 100.0 * bits / ((float) us * bitrate / 1000000.0);
+}
+
+
+// static
+uint32_t myCANDriverBase::latencyPercentile(const myCANStats *stats, int percent)
+{
+	uint32_t total = 0;
+	for (int i=0; i<CAN_LATENCY_BUCKETS; i++)
+		total += stats->latency[i];
+	if (!total)
+		return 0;
+
+	uint32_t want = ((uint64_t) total * percent + 99) / 100;
+	uint32_t sum = 0;
+	for (int i=0; i<CAN_LATENCY_BUCKETS - 1; i++)
+	{
+		sum += stats->latency[i];
+		if (sum >= want)
+			return (2UL << i) - 1;
+	}
+	return stats->latency_max;
+}
+
+
+// static
+int myCANDriverBase::frameBits(const myCANFrame *frame)
+	// Lays out the frame from SOF to the end of the data, computes
+	// the CRC15 over it, and counts the stuff bits, one after every
+	// five equal bits, up to the end of the CRC. A stuff bit starts
+	// the next run itself.
+{
+	uint8_t bits[128];
+	int n = 0;
+
+	#define PUT_BITS(value,count) \
+		for (int b=(count)-1; b>=0; b--) \
+			bits[n++] = ((value) >> b) & 1;
+
+	bool ext = frame->flags & CAN_FRAME_EXT;
+	bool rtr = frame->flags & CAN_FRAME_RTR;
+	int len = frame->len > 8 ? 8 : frame->len;
+
+	PUT_BITS(0,1);							// SOF
+	if (ext)
+	{
+		PUT_BITS(frame->id >> 18,11);
+		PUT_BITS(1,1);						// SRR
+		PUT_BITS(1,1);						// IDE
+		PUT_BITS(frame->id & 0x3ffff,18);
+		PUT_BITS(rtr,1);
+		PUT_BITS(0,2);						// r1 r0
+	}
+	else
+	{
+		PUT_BITS(frame->id,11);
+		PUT_BITS(rtr,1);
+		PUT_BITS(0,2);						// IDE r0
+	}
+	PUT_BITS(len,4);
+	if (!rtr)
+		for (int i=0; i<len; i++)
+			PUT_BITS(frame->data[i],8);
+
+	uint16_t crc = 0;
+	for (int i=0; i<n; i++)
+	{
+		bool next = bits[i] ^ ((crc >> 14) & 1);
+		crc = (crc << 1) & 0x7fff;
+		if (next)
+			crc ^= 0x4599;
+	}
+	PUT_BITS(crc,15);
+
+	#undef PUT_BITS
+
+	int stuff = 0;
+	int run = 0;
+	uint8_t last = 2;
+	for (int i=0; i<n; i++)
+	{
+		if (bits[i] == last)
+			run++;
+		else
+		{
+			last = bits[i];
+			run = 1;
+		}
+		if (run == 5)
+		{
+			stuff++;
+			last = !last;
+			run = 1;
+		}
+	}
+
+	return n + stuff + 13;
+}
+
+
+
+// static
+uint32_t myCANDriverBase::arbitrationKey(const myCANFrame *frame)
+	// Ordered as the bits go out on the bus, where a dominant 0 wins:
+	// the 11 bit base id, then RTR for a standard frame or SRR for an
+	// extended one, then IDE, then the 18 bit extension, and its RTR.
+	// So a standard frame beats an extended one with the same base id.
+{
+	bool rtr = frame->flags & CAN_FRAME_RTR;
+	if (!(frame->flags & CAN_FRAME_EXT))
+		return ((frame->id & 0x7ff) << 21) | (rtr ? (1UL << 20) : 0);
+	return
+		((frame->id >> 18) << 21) |
+		(1UL << 20) |
+		(1UL << 19) |
+		((frame->id & 0x3ffff) << 1) |
+		(rtr ? 1 : 0);
+}
@@ -0,0 +1,290 @@
+//-------------------------------------------
+// myCANDriver.h
+//-------------------------------------------
+// An interrupt driven CAN driver over a myCANBackend, usually
+// an MCP2515 through the github/autowp/arduino-mcp2515 library.
+//
+// The controller's INT pin wakes a high priority task that drains
+// the received frames, and any error flags, until the pin goes high
+// again, and pushes the frames into a lock-free single producer,
+// single consumer ring. The application takes frames from the ring
+// in batches with receive(), or peek() and consume() to avoid the
+// copy, so there is no SPI traffic on its side at all.
+//
+//		myCANMcp2515 backend(CAN_CS_PIN);
+//		myCANDriverT<myCANMcp2515> can(&backend,CAN_INT_PIN);
+//
+//		setup():
+//			can.begin(250000);
+//			can.startTask();
+//
+//		loop():
+//			myCANFrame frames[16];
+//			int n = can.receive(frames,16);
+//
+// Without an INT pin, or a task, call poll() from loop()
+// to move frames from the controller to the ring. On a host,
+// with the loopback or SocketCAN backends, there is no task.
+//
+// The driver is a template on its backend. As the backends are
+// final classes, myCANDriverT<myCANMcp2515> calls them directly,
+// and inlines the small ones, rather than through the vtable on
+// every frame. myCANDriver, on myCANBackend itself, takes any
+// backend at run time, as the host tools do. myCANBUS.h picks the
+// backend for a sketch at compile time.
+//
+// setFilters() installs a myCANFilter into the controller's masks
+// and filters, and drops whatever they let through that the filter
+// does not match before it reaches the ring.
+//
+// send() queues a frame by arbitration priority, and the task keeps
+// the backend's TX slots, all three TX buffers of an MCP2515, loaded
+// from the head of the queue, ranked in the same order, refilling
+// them as each one goes. If the head of the queue outranks all of
+// the loaded frames, the lowest one is aborted and requeued, so that
+// bulk traffic losing arbitration on a busy bus does not hold up a
+// high priority frame. With a single slot, frames go out one at a
+// time, still in priority order.
+//
+// getStats() returns a snapshot of the driver's counters, that any
+// task may take, including the bits on the wire, with stuff bits,
+// CRC, and the frame trailer, of every frame received or sent, from
+// which busLoad() gives the utilization between two snapshots, as
+// seen by this node, after the hardware filters. The controller's
+// TEC and REC are read every CAN_ERRCOUNT_MS, and the time poll()
+// spends talking to it is totalled, along with the backend's count
+// of SPI transactions and bytes, for the cost of each frame. Frames
+// are stamped with the time of the INT edge, if they were waiting
+// when it fell, and receive() and consume() add the time from then
+// to a log2 histogram of the latency to the application.
+//
+// setCapture() records the traffic into a myCANCapture, to be
+// flushed to a Print by the application.
+
+#pragma once
+
+#include <Arduino.h>
+#include "myCANFrame.h"
+#include "myCANBackend.h"
+
+#ifndef CAN_RX_RING_SIZE
+	#define CAN_RX_RING_SIZE		128		// frames, must be a power of 2
+#endif
+#ifndef CAN_TASK_CORE
+	#define CAN_TASK_CORE			0
+#endif
+#ifndef CAN_TASK_PRIORITY
+	#define CAN_TASK_PRIORITY		20		// above everything but the system
+#endif
+#ifndef CAN_POLL_MS
+	#define CAN_POLL_MS				10		// in case an edge is missed
+#endif
+
+#ifndef CAN_TX_QUEUE_SIZE
+	#define CAN_TX_QUEUE_SIZE		32		// frames
+#endif
+
+#ifndef CAN_LATENCY_BUCKETS
+	#define CAN_LATENCY_BUCKETS		16		// log2 microseconds
+#endif
+#ifndef CAN_ERRCOUNT_MS
+	#define CAN_ERRCOUNT_MS			250		// how often TEC and REC are read
+#endif
+
+class myCANFilter;
+class myCANCapture;
+
+
+typedef struct
+{
+	uint32_t time;				// micros() when taken
+	uint32_t rx_frames;
+	uint32_t rx_bits;			// on the wire, wrapping
+	uint32_t tx_frames;
+	uint32_t tx_bits;
+	uint32_t chip_overflows;
+	uint32_t ring_overflows;
+	uint32_t sw_rejected;
+	uint32_t tx_aborts;
+	uint32_t tx_overflows;
+	uint32_t polls;
+	uint32_t spi_us;			// in poll(), talking to the controller
+	uint32_t spi_transactions;	// chip selects, from the backend
+	uint32_t spi_bytes;
+	uint8_t tec;				// transmit error counter
+	uint8_t rec;				// receive error counter
+	uint8_t eflg;				// error flags
+	uint32_t latency[CAN_LATENCY_BUCKETS];
+		// bucket i counts latencies of [2^i, 2^(i+1)) microseconds,
+		// and the last one everything above
+	uint32_t latency_max;
+} myCANStats;
+
+
+class myCANDriverBase
+	// what does not depend on the backend
+{
+public:
+
+	static float busLoad(const myCANStats *prev, const myCANStats *now, uint32_t bitrate=250000);
+		// percent of the bus used between two snapshots
+	static uint32_t latencyPercentile(const myCANStats *stats, int percent);
+		// the upper bound, in microseconds, of the bucket it falls in
+	static int frameBits(const myCANFrame *frame);
+		// bits on the wire, including stuff bits, and the
+		// 13 bits of CRC delimiter, ACK, EOF, and intermission
+
+protected:
+
+	static uint32_t arbitrationKey(const myCANFrame *frame);
+};
+
+
+template <class BACKEND>
+class myCANDriverT : public myCANDriverBase
+{
+public:
+
+	myCANDriverT(BACKEND *backend, int int_pin=-1);
+
+	bool begin(uint32_t bitrate=250000);
+		// starts the backend at the bitrate;
+		// reports an error and returns false on failure
+
+	#ifdef ESP32
+		void startTask(int core=CAN_TASK_CORE, int priority=CAN_TASK_PRIORITY);
+			// attaches the INT pin interrupt, and starts the task
+			// that does all the talking to the controller
+	#endif
+
+	bool setFilters(myCANFilter *filter, uint32_t calibrate_ms=0);
+		// Compiles and installs the filter, or accepts everything if
+		// NULL. With calibrate_ms, the hardware filters are left open
+		// that long, while the traffic is counted against the filter,
+		// and then installed by poll(), which shows filter->report().
+		// Call before startTask(). Returns false on an error.
+	void setCapture(myCANCapture *capture)  { m_capture = capture; }
+		// records every frame received, before the software filter,
+		// and sent, as it completes, until set to NULL
+
+	int poll();
+		// moves any frames from the controller to the ring and
+		// returns the number moved, and refills the TX slots
+		// from the queue; called by the task
+
+	bool send(const myCANFrame *frame);
+		// queues the frame by priority; the time is ignored
+		// returns false if the queue is full
+	int txPending();
+		// frames queued or in the TX slots
+
+	int available()  { return m_rx.count(); }
+	int receive(myCANFrame *frames, int max);
+		// copies up to max frames, oldest first, and returns the number
+	const myCANFrame *peek(int *n)  { return m_rx.peek(n); }
+	void consume(int n);
+		// the same without the copy
+
+	uint32_t getRxCount()			{ return m_rx_count; }
+	uint32_t getChipOverflows()		{ return m_backend->getOverflows(); }
+		// frames lost in the controller
+	uint32_t getRingOverflows()		{ return m_ring_overflows; }
+		// frames lost because the application did not keep up
+	uint32_t getSwRejected()		{ return m_sw_rejected; }
+		// frames dropped by the software filter
+	uint32_t getTxCount()			{ return m_tx_count; }
+	uint32_t getTxAborts()			{ return m_tx_aborts; }
+		// frames pulled back from the controller for a higher priority one
+	uint32_t getTxOverflows()		{ return m_tx_overflows; }
+		// frames refused by send()
+
+	void getStats(myCANStats *stats);
+		// from any task; each counter is exact, though one may be a
+		// frame ahead of another, and the histogram is consistent
+
+
+private:
+
+	BACKEND *m_backend;
+	int m_int_pin;
+
+	myCANRing<CAN_RX_RING_SIZE> m_rx;
+
+	volatile uint32_t m_rx_count;
+	volatile uint32_t m_ring_overflows;
+	volatile uint32_t m_sw_rejected;
+	volatile uint32_t m_rx_bits;
+	volatile uint32_t m_tx_bits;
+	volatile uint32_t m_polls;
+	volatile uint32_t m_spi_us;
+	volatile uint8_t m_tec;
+	volatile uint8_t m_rec;
+	volatile uint8_t m_eflg;
+	uint32_t m_errcount_time;
+
+	volatile uint32_t m_isr_time;
+	uint32_t m_stamp;
+
+	// written only by the consumer
+
+	volatile uint32_t m_lat_seq;
+	uint32_t m_latency[CAN_LATENCY_BUCKETS];
+	uint32_t m_latency_max;
+	void addLatency(const myCANFrame *frames, int n);
+
+	myCANFilter *m_filter;
+	bool m_calibrating;
+	uint32_t m_calibrate_ms;
+	uint32_t m_calibrate_start;
+	myCANCapture *m_capture;
+
+	void receiveFrame(myCANFrame *frame);
+
+	// transmit
+
+	typedef struct
+	{
+		uint32_t key;		// lower wins arbitration
+		uint32_t seq;		// and then first queued
+		myCANFrame frame;
+	} txEntry_t;
+
+	txEntry_t m_tx_heap[CAN_TX_QUEUE_SIZE + CAN_MAX_TX_SLOTS];
+		// room for the aborted frames to go back
+	int m_tx_num;
+	uint32_t m_tx_seq;
+
+	txEntry_t m_tx_slot[CAN_MAX_TX_SLOTS];
+	bool m_tx_busy[CAN_MAX_TX_SLOTS];
+	bool m_tx_abort[CAN_MAX_TX_SLOTS];
+	uint8_t m_tx_txp[CAN_MAX_TX_SLOTS];
+
+	volatile uint32_t m_tx_count;
+	volatile uint32_t m_tx_aborts;
+	volatile uint32_t m_tx_overflows;
+
+	#ifdef ESP32
+		portMUX_TYPE m_tx_mux;
+	#endif
+
+	static bool txBefore(const txEntry_t *a, const txEntry_t *b);
+	void txPush(const txEntry_t *entry);
+	void txPop(txEntry_t *entry);
+	void completeTx(uint8_t events);
+	void fillTx();
+	void rankTx();
+
+	#ifdef ESP32
+		TaskHandle_t m_task;
+		static void rxTask(void *param);
+		static void IRAM_ATTR intISR(void *param);
+	#endif
+
+};
+
+
+typedef myCANDriverT<myCANBackend> myCANDriver;
+	// any backend, through its virtual methods
+
+
+#include "myCANDriverImpl.h"
@@ -0,0 +1,510 @@
+//-------------------------------------------
+// myCANDriverImpl.h
+//-------------------------------------------
+// The myCANDriverT template methods, included by myCANDriver.h.
+// Nothing here calls through a virtual method when the backend
+// class is final.
+
+#pragma once
+
+#include "myCANFilter.h"
+#include "myCANCapture.h"
+
+#ifdef ESP32
+	#define CAN_TX_LOCK()		portENTER_CRITICAL(&m_tx_mux)
+	#define CAN_TX_UNLOCK()		portEXIT_CRITICAL(&m_tx_mux)
+#else
+	#define CAN_TX_LOCK()
+	#define CAN_TX_UNLOCK()
+#endif
+
+
+template <class BACKEND>
+myCANDriverT<BACKEND>::myCANDriverT(BACKEND *backend, int int_pin/*=-1*/) :
+	m_backend(backend),
+	m_int_pin(int_pin),
+	m_rx_count(0),
+	m_ring_overflows(0),
+	m_sw_rejected(0),
+	m_rx_bits(0),
+	m_tx_bits(0),
+	m_polls(0),
+	m_spi_us(0),
+	m_tec(0),
+	m_rec(0),
+	m_eflg(0),
+	m_errcount_time(0),
+	m_isr_time(0),
+	m_stamp(0),
+	m_lat_seq(0),
+	m_latency_max(0),
+	m_filter(NULL),
+	m_calibrating(0),
+	m_calibrate_ms(0),
+	m_calibrate_start(0),
+	m_capture(NULL),
+	m_tx_num(0),
+	m_tx_seq(0),
+	m_tx_count(0),
+	m_tx_aborts(0),
+	m_tx_overflows(0)
+{
+	memset(m_latency,0,sizeof(m_latency));
+	memset(m_tx_busy,0,sizeof(m_tx_busy));
+	memset(m_tx_abort,0,sizeof(m_tx_abort));
+	memset(m_tx_txp,0,sizeof(m_tx_txp));
+	#ifdef ESP32
+		m_task = NULL;
+		m_tx_mux = portMUX_INITIALIZER_UNLOCKED;
+	#endif
+}
+
+
+template <class BACKEND>
+bool myCANDriverT<BACKEND>::begin(uint32_t bitrate/*=250000*/)
+{
+	return m_backend->begin(bitrate);
+}
+
+
+template <class BACKEND>
+void myCANDriverT<BACKEND>::receiveFrame(myCANFrame *frame)
+{
+	frame->time = m_stamp ? m_stamp : micros();
+	m_rx_count++;
+	m_rx_bits += frameBits(frame);
+	if (m_capture)
+		m_capture->add(frame,false);
+	if (m_filter)
+	{
+		if (m_calibrating)
+			m_filter->calibrate(frame);
+		if (!m_filter->match(frame))
+		{
+			m_sw_rejected++;
+			return;
+		}
+	}
+	if (!m_rx.push(frame))
+		m_ring_overflows++;
+}
+
+
+template <class BACKEND>
+bool myCANDriverT<BACKEND>::setFilters(myCANFilter *filter, uint32_t calibrate_ms/*=0*/)
+{
+	m_filter = filter;
+	m_calibrating = 0;
+	if (filter)
+	{
+		filter->compile();
+		if (calibrate_ms && !filter->isOpen())
+		{
+			m_calibrate_ms = calibrate_ms;
+			m_calibrate_start = millis();
+			filter->startCalibration();
+			m_calibrating = 1;
+			return true;
+		}
+	}
+	return m_backend->setFilters(filter);
+}
+
+
+template <class BACKEND>
+int myCANDriverT<BACKEND>::poll()
+{
+	if (m_calibrating && millis() - m_calibrate_start >= m_calibrate_ms)
+	{
+		m_calibrating = 0;
+		m_filter->endCalibration();
+		m_backend->setFilters(m_filter);
+		m_filter->report();
+	}
+
+	uint32_t start = micros();
+	if (millis() - m_errcount_time >= CAN_ERRCOUNT_MS)
+	{
+		m_errcount_time = millis();
+		uint8_t tec,rec,flags;
+		m_backend->getErrorCounts(&tec,&rec,&flags);
+		m_tec = tec;
+		m_rec = rec;
+		m_eflg = flags;
+	}
+
+	int n = 0;
+	while (1)
+	{
+		uint8_t events = m_backend->getEvents();
+		completeTx(events);
+		fillTx();
+		if (!(events & CAN_EVENT_RX))
+			break;
+
+		myCANFrame frame;
+		while (m_backend->read(&frame))
+		{
+			receiveFrame(&frame);
+			n++;
+		}
+
+		// later frames arrived after the edge
+		m_stamp = 0;
+	}
+
+	m_stamp = 0;
+	m_polls++;
+	m_spi_us += micros() - start;
+	return n;
+}
+
+
+template <class BACKEND>
+int myCANDriverT<BACKEND>::receive(myCANFrame *frames, int max)
+{
+	int n = m_rx.pop(frames,max);
+	addLatency(frames,n);
+	return n;
+}
+
+
+template <class BACKEND>
+void myCANDriverT<BACKEND>::consume(int n)
+{
+	int avail;
+	const myCANFrame *frames = m_rx.peek(&avail);
+	addLatency(frames,n < avail ? n : avail);
+	m_rx.consume(n);
+}
+
+
+
+//-----------------------------------
+// instrumentation
+//-----------------------------------
+
+template <class BACKEND>
+void myCANDriverT<BACKEND>::addLatency(const myCANFrame *frames, int n)
+{
+	if (!n)
+		return;
+	uint32_t now = micros();
+
+	m_lat_seq++;
+	__sync_synchronize();
+	for (int i=0; i<n; i++)
+	{
+		uint32_t us = now - frames[i].time;
+		int bucket = 0;
+		while (bucket < CAN_LATENCY_BUCKETS - 1 && (us >> (bucket + 1)))
+			bucket++;
+		m_latency[bucket]++;
+		if (us > m_latency_max)
+			m_latency_max = us;
+	}
+	__sync_synchronize();
+	m_lat_seq++;
+}
+
+
+template <class BACKEND>
+void myCANDriverT<BACKEND>::getStats(myCANStats *stats)
+{
+	stats->time = micros();
+	stats->rx_frames = m_rx_count;
+	stats->rx_bits = m_rx_bits;
+	stats->tx_frames = m_tx_count;
+	stats->tx_bits = m_tx_bits;
+	stats->chip_overflows = m_backend->getOverflows();
+	stats->ring_overflows = m_ring_overflows;
+	stats->sw_rejected = m_sw_rejected;
+	stats->tx_aborts = m_tx_aborts;
+	stats->tx_overflows = m_tx_overflows;
+	stats->polls = m_polls;
+	stats->spi_us = m_spi_us;
+	m_backend->getSpiCounts(&stats->spi_transactions,&stats->spi_bytes);
+	stats->tec = m_tec;
+	stats->rec = m_rec;
+	stats->eflg = m_eflg;
+
+	uint32_t seq;
+	do
+	{
+		seq = m_lat_seq;
+		__sync_synchronize();
+		memcpy(stats->latency,m_latency,sizeof(m_latency));
+		stats->latency_max = m_latency_max;
+		__sync_synchronize();
+	}	while ((seq & 1) || seq != m_lat_seq);
+}
+
+
+//-----------------------------------
+// transmit
+//-----------------------------------
+
+template <class BACKEND>
+bool myCANDriverT<BACKEND>::txBefore(const txEntry_t *a, const txEntry_t *b)
+{
+	if (a->key != b->key)
+		return a->key < b->key;
+	return (int32_t)(a->seq - b->seq) < 0;
+}
+
+
+template <class BACKEND>
+void myCANDriverT<BACKEND>::txPush(const txEntry_t *entry)
+	// binary heap with the next frame to send at the top
+	// called with the lock held
+{
+	int i = m_tx_num++;
+	while (i)
+	{
+		int parent = (i - 1) / 2;
+		if (!txBefore(entry,&m_tx_heap[parent]))
+			break;
+		m_tx_heap[i] = m_tx_heap[parent];
+		i = parent;
+	}
+	m_tx_heap[i] = *entry;
+}
+
+
+template <class BACKEND>
+void myCANDriverT<BACKEND>::txPop(txEntry_t *entry)
+	// called with the lock held
+{
+	*entry = m_tx_heap[0];
+	const txEntry_t *last = &m_tx_heap[--m_tx_num];
+	int i = 0;
+	while (1)
+	{
+		int child = 2 * i + 1;
+		if (child >= m_tx_num)
+			break;
+		if (child + 1 < m_tx_num && txBefore(&m_tx_heap[child+1],&m_tx_heap[child]))
+			child++;
+		if (!txBefore(&m_tx_heap[child],last))
+			break;
+		m_tx_heap[i] = m_tx_heap[child];
+		i = child;
+	}
+	m_tx_heap[i] = *last;
+}
+
+
+template <class BACKEND>
+bool myCANDriverT<BACKEND>::send(const myCANFrame *frame)
+{
+	txEntry_t entry;
+	entry.key = arbitrationKey(frame);
+	entry.frame = *frame;
+
+	bool ok = false;
+	CAN_TX_LOCK();
+	if (m_tx_num < CAN_TX_QUEUE_SIZE)
+	{
+		entry.seq = m_tx_seq++;
+		txPush(&entry);
+		ok = true;
+	}
+	CAN_TX_UNLOCK();
+
+	if (!ok)
+	{
+		m_tx_overflows++;
+		return false;
+	}
+
+	// the buffers are loaded from the task, if there is one,
+	// so that all the SPI traffic comes from one place
+
+	#ifdef ESP32
+		if (m_task)
+		{
+			xTaskNotifyGive(m_task);
+			return true;
+		}
+	#endif
+	fillTx();
+	return true;
+}
+
+
+template <class BACKEND>
+int myCANDriverT<BACKEND>::txPending()
+{
+	CAN_TX_LOCK();
+	int n = m_tx_num;
+	CAN_TX_UNLOCK();
+	for (int b=0; b<CAN_MAX_TX_SLOTS; b++)
+		if (m_tx_busy[b])
+			n++;
+	return n;
+}
+
+
+template <class BACKEND>
+void myCANDriverT<BACKEND>::completeTx(uint8_t events)
+{
+	int num_slots = m_backend->getTxSlots();
+	for (int b=0; b<num_slots; b++)
+	{
+		if (!m_tx_busy[b])
+			continue;
+		if (events & (CAN_EVENT_TX0 << b))
+		{
+			m_tx_busy[b] = 0;
+			m_tx_abort[b] = 0;
+			m_tx_count++;
+			m_tx_bits += frameBits(&m_tx_slot[b].frame);
+			if (m_capture)
+			{
+				// with the same stamp as the frames read after it
+
+				m_tx_slot[b].frame.time = m_stamp ? m_stamp : micros();
+				m_capture->add(&m_tx_slot[b].frame,true);
+			}
+		}
+		else if (m_tx_abort[b] && m_backend->aborted(b))
+		{
+			CAN_TX_LOCK();
+			txPush(&m_tx_slot[b]);
+			CAN_TX_UNLOCK();
+			m_tx_busy[b] = 0;
+			m_tx_abort[b] = 0;
+			m_tx_aborts++;
+		}
+	}
+}
+
+
+template <class BACKEND>
+void myCANDriverT<BACKEND>::rankTx()
+	// gives the loaded slots ranks 3, 2, 1 in priority order
+{
+	int num_slots = m_backend->getTxSlots();
+	for (int b=0; b<num_slots; b++)
+	{
+		if (!m_tx_busy[b])
+			continue;
+		uint8_t rank = 3;
+		for (int o=0; o<num_slots; o++)
+			if (o != b && m_tx_busy[o] && txBefore(&m_tx_slot[o],&m_tx_slot[b]))
+				rank--;
+		if (rank != m_tx_txp[b])
+		{
+			m_backend->setRank(b,rank);
+			m_tx_txp[b] = rank;
+		}
+	}
+}
+
+
+template <class BACKEND>
+void myCANDriverT<BACKEND>::fillTx()
+{
+	int num_slots = m_backend->getTxSlots();
+	while (1)
+	{
+		int free_slot = -1;
+		for (int b=0; b<num_slots && free_slot<0; b++)
+			if (!m_tx_busy[b])
+				free_slot = b;
+
+		CAN_TX_LOCK();
+		if (!m_tx_num)
+		{
+			CAN_TX_UNLOCK();
+			return;
+		}
+
+		if (free_slot < 0)
+		{
+			// abort the lowest loaded frame if the queue outranks it
+
+			int worst = -1;
+			for (int b=0; b<num_slots; b++)
+				if (!m_tx_abort[b] && (worst < 0 || txBefore(&m_tx_slot[worst],&m_tx_slot[b])))
+					worst = b;
+			bool abort = num_slots > 1 && worst >= 0 &&
+				txBefore(&m_tx_heap[0],&m_tx_slot[worst]);
+			CAN_TX_UNLOCK();
+
+			if (abort && m_backend->abort(worst))
+				m_tx_abort[worst] = 1;
+			return;
+		}
+
+		txEntry_t *slot = &m_tx_slot[free_slot];
+		txPop(slot);
+		CAN_TX_UNLOCK();
+
+		// rank it before it is requested, so it does not go out of order
+
+		m_tx_busy[free_slot] = 1;
+		m_tx_abort[free_slot] = 0;
+		if (num_slots > 1)
+			rankTx();
+		m_backend->load(free_slot,&slot->frame);
+	}
+}
+
+
+#ifdef ESP32
+
+	template <class BACKEND>
+	void IRAM_ATTR myCANDriverT<BACKEND>::intISR(void *param)
+	{
+		myCANDriverT<BACKEND> *self = (myCANDriverT<BACKEND> *) param;
+		self->m_isr_time = micros();
+		BaseType_t woken = pdFALSE;
+		vTaskNotifyGiveFromISR(self->m_task,&woken);
+		portYIELD_FROM_ISR(woken);
+	}
+
+
+	template <class BACKEND>
+	void myCANDriverT<BACKEND>::rxTask(void *param)
+	{
+		myCANDriverT<BACKEND> *self = (myCANDriverT<BACKEND> *) param;
+		while (1)
+		{
+			if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CAN_POLL_MS)))
+				self->m_stamp = self->m_isr_time;
+
+			// INT stays low until every flag has been serviced
+
+			do
+			{
+				self->poll();
+			}	while (self->m_int_pin >= 0 && !digitalRead(self->m_int_pin));
+		}
+	}
+
+
+	template <class BACKEND>
+	void myCANDriverT<BACKEND>::startTask(int core/*=CAN_TASK_CORE*/, int priority/*=CAN_TASK_PRIORITY*/)
+	{
+		xTaskCreatePinnedToCore(
+			rxTask,
+			"canRxTask",
+			4096,	// stack
+			this,	// param
+			priority,
+			&m_task,
+			core);
+
+		if (m_int_pin >= 0)
+		{
+			pinMode(m_int_pin,INPUT_PULLUP);
+			attachInterruptArg(m_int_pin,intISR,this,FALLING);
+		}
+	}
+
+#endif
+
+
+#undef CAN_TX_LOCK
+#undef CAN_TX_UNLOCK
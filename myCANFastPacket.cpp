@@ -0,0 +1,635 @@
+//-------------------------------------------
+// myCANFastPacket.cpp
+//-------------------------------------------
+
+#include "myCANFastPacket.h"
+#include <myDebug.h>
+
+#define ID_KEY_MASK		0x03FFFFFF		// all but the priority
+#define TIMEOUT_US		((uint32_t) CAN_FP_TIMEOUT_MS * 1000)
+#define TP_TIMEOUT_US	((uint32_t) CAN_TP_TIMEOUT_MS * 1000)
+#define TP_KEY			0x80000000		// | channel, beyond any id key
+
+// ISO-TP frame types, in the top 4 bits of the first byte,
+// and the flow statuses, in the low 4 bits of a flow control
+
+#define TP_SINGLE		0
+#define TP_FIRST		1
+#define TP_CONSECUTIVE	2
+#define TP_FLOW			3
+
+#define TP_FC_CTS		0
+#define TP_FC_WAIT		1
+#define TP_FC_OVERFLOW	2
+
+
+myCANFastPacket::myCANFastPacket() :
+	m_num_pgns(0),
+	m_tx_seq(0),
+	m_num_channels(0),
+	m_completed(0),
+	m_timeouts(0),
+	m_restarts(0),
+	m_evictions(0),
+	m_dropped(0),
+	m_overflows(0),
+	m_tp_sent(0),
+	m_tp_aborts(0)
+{
+	memset(m_sessions,0,sizeof(m_sessions));
+	memset(&m_single,0,sizeof(m_single));
+	memset(m_channels,0,sizeof(m_channels));
+}
+
+
+bool myCANFastPacket::addPgn(uint32_t pgn)
+{
+	if (isFastPacket(pgn))
+		return true;
+	if (m_num_pgns >= CAN_FP_MAX_PGNS)
+	{
+		my_error("CAN_FP_MAX_PGNS(%d) exceeded",CAN_FP_MAX_PGNS);
+		return false;
+	}
+	m_pgns[m_num_pgns++] = pgn;
+	return true;
+}
+
+
+bool myCANFastPacket::isFastPacket(uint32_t pgn)
+{
+	for (int i=0; i<m_num_pgns; i++)
+		if (m_pgns[i] == pgn)
+			return true;
+	return false;
+}
+
+
+// static
+int myCANFastPacket::numFrames(int len)
+{
+	return len <= 6 ? 1 : 1 + (len - 6 + 6) / 7;
+}
+
+
+// static
+uint32_t myCANFastPacket::getPgn(uint32_t id)
+	// the PS byte of a PDU1 PGN is the destination address
+{
+	uint32_t pgn = (id >> 8) & 0x3FFFF;
+	if (((pgn >> 8) & 0xff) < 240)
+		pgn &= 0x3FF00;
+	return pgn;
+}
+
+
+// static
+uint32_t myCANFastPacket::makeId(int priority, uint32_t pgn, int source, int dest/*=CAN_N2K_BROADCAST*/)
+{
+	uint32_t id = ((uint32_t) (priority & 7) << 26) | ((pgn & 0x3FFFF) << 8) | (source & 0xff);
+	if (((pgn >> 8) & 0xff) < 240)
+		id = (id & ~0xff00UL) | ((dest & 0xff) << 8);
+	return id;
+}
+
+
+void myCANFastPacket::setMessage(myCANMessage *msg, const myCANFrame *frame)
+{
+	msg->time = frame->time;
+	msg->id = frame->id;
+	msg->pgn = getPgn(frame->id);
+	msg->priority = (frame->id >> 26) & 7;
+	msg->source = frame->id & 0xff;
+	msg->dest = ((msg->pgn >> 8) & 0xff) < 240 ? (frame->id >> 8) & 0xff : CAN_N2K_BROADCAST;
+}
+
+
+//-----------------------------------
+// sessions
+//-----------------------------------
+
+// static
+uint32_t myCANFastPacket::sessionTimeout(const session_t *s)
+{
+	return s->key & TP_KEY ? TP_TIMEOUT_US : TIMEOUT_US;
+}
+
+
+void myCANFastPacket::expire(uint32_t now)
+{
+	for (int i=0; i<CAN_FP_SESSIONS; i++)
+	{
+		session_t *s = &m_sessions[i];
+		if (s->state == FP_BUSY && now - s->last > sessionTimeout(s))
+		{
+			s->state = FP_FREE;
+			m_timeouts++;
+		}
+	}
+}
+
+
+myCANFastPacket::session_t *myCANFastPacket::findSession(uint32_t key, uint8_t seq, uint32_t time)
+{
+	for (int i=0; i<CAN_FP_SESSIONS; i++)
+	{
+		session_t *s = &m_sessions[i];
+		if (s->state == FP_BUSY && s->key == key && s->seq == seq)
+		{
+			if (time - s->last <= sessionTimeout(s))
+				return s;
+			s->state = FP_FREE;
+			m_timeouts++;
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+
+myCANFastPacket::session_t *myCANFastPacket::newSession(uint32_t key, uint8_t seq, uint32_t time)
+	// a free session, or the oldest one being assembled
+{
+	expire(time);
+
+	session_t *found = NULL;
+	for (int i=0; i<CAN_FP_SESSIONS && !found; i++)
+		if (m_sessions[i].state == FP_FREE)
+			found = &m_sessions[i];
+
+	if (!found)
+	{
+		for (int i=0; i<CAN_FP_SESSIONS; i++)
+		{
+			session_t *s = &m_sessions[i];
+			if (s->state == FP_BUSY &&
+				(!found || (int32_t) (s->last - found->last) < 0))
+				found = s;
+		}
+		if (!found)
+			return NULL;		// all held by the caller
+		m_evictions++;
+	}
+
+	found->state = FP_BUSY;
+	found->key = key;
+	found->seq = seq;
+	found->len = -1;
+	found->have = 0;
+	found->last = time;
+	return found;
+}
+
+
+void myCANFastPacket::release(const myCANMessage *msg)
+{
+	for (int i=0; i<CAN_FP_SESSIONS; i++)
+	{
+		session_t *s = &m_sessions[i];
+		if (&s->msg == msg)
+		{
+			s->state = FP_FREE;
+			return;
+		}
+	}
+}
+
+
+//-----------------------------------
+// reassembly
+//-----------------------------------
+
+const myCANMessage *myCANFastPacket::process(const myCANFrame *frame)
+{
+	if (frame->flags & CAN_FRAME_RTR)
+		return NULL;
+	channel_t *ch = findChannel(frame->id,frame->flags & CAN_FRAME_EXT,false);
+	if (ch)
+		return processIsoTp(ch - m_channels,frame);
+	if (!(frame->flags & CAN_FRAME_EXT))
+		return NULL;
+
+	uint32_t pgn = getPgn(frame->id);
+	if (!isFastPacket(pgn))
+	{
+		setMessage(&m_single,frame);
+		m_single.len = frame->len;
+		m_single.data = frame->data;
+		return &m_single;
+	}
+	if (!frame->len)
+	{
+		m_dropped++;
+		return NULL;
+	}
+
+	uint32_t key = frame->id & ID_KEY_MASK;
+	uint8_t seq = frame->data[0] >> 5;
+	int counter = frame->data[0] & 0x1f;
+
+	session_t *s = findSession(key,seq,frame->time);
+	if (s && !counter && (s->have & 1))
+	{
+		// frame 0 again, so the rest of the old one was lost
+		m_restarts++;
+		s->state = FP_FREE;
+		s = NULL;
+	}
+	if (!s)
+		s = newSession(key,seq,frame->time);
+	if (!s || (s->have & (1UL << counter)))
+	{
+		m_dropped++;
+		return NULL;
+	}
+
+	// place the data by its frame counter
+
+	const uint8_t *src;
+	int offset;
+	int n;
+	if (!counter)
+	{
+		if (frame->len < 2 || frame->data[1] > CAN_FP_MAX_LEN)
+		{
+			s->state = FP_FREE;
+			m_dropped++;
+			return NULL;
+		}
+		s->len = frame->data[1];
+		src = &frame->data[2];
+		offset = 0;
+		n = frame->len - 2;
+		if (n > 6)
+			n = 6;
+	}
+	else
+	{
+		src = &frame->data[1];
+		offset = 6 + (counter - 1) * 7;
+		n = frame->len - 1;
+		if (n > 7)
+			n = 7;
+	}
+	if (offset + n > CAN_FP_MAX_LEN)
+		n = CAN_FP_MAX_LEN - offset;
+	memcpy(&s->data[offset],src,n);
+	s->have |= 1UL << counter;
+	s->last = frame->time;
+
+	if (s->len < 0)
+		return NULL;
+	int need = numFrames(s->len);
+	uint32_t all = need >= 32 ? 0xFFFFFFFF : (1UL << need) - 1;
+	if ((s->have & all) != all)
+		return NULL;
+
+	s->state = FP_HELD;
+	setMessage(&s->msg,frame);
+	s->msg.len = s->len;
+	s->msg.data = s->data;
+	m_completed++;
+	return &s->msg;
+}
+
+
+//-----------------------------------
+// segmentation
+//-----------------------------------
+
+int myCANFastPacket::segment(uint32_t id, const uint8_t *data, int len, myCANFrame *frames, int max)
+{
+	int num = numFrames(len);
+	if (len < 0 || len > CAN_FP_MAX_LEN || num > max)
+		return 0;
+
+	uint8_t seq = m_tx_seq;
+	m_tx_seq = (m_tx_seq + 1) & 7;
+
+	int pos = 0;
+	for (int i=0; i<num; i++)
+	{
+		myCANFrame *frame = &frames[i];
+		frame->time = 0;
+		frame->id = id;
+		frame->flags = CAN_FRAME_EXT;
+		frame->len = 8;
+		memset(frame->data,0xff,8);
+		frame->data[0] = (seq << 5) | i;
+
+		int k = 1;
+		if (!i)
+			frame->data[k++] = len;
+		while (k < 8 && pos < len)
+			frame->data[k++] = data[pos++];
+	}
+	return num;
+}
+
+
+//-----------------------------------
+// ISO-TP
+//-----------------------------------
+
+static uint32_t stminUs(uint8_t stmin)
+	// 0..127 ms, or 100..900 us, and the reserved values as the longest
+{
+	if (stmin <= 0x7f)
+		return (uint32_t) stmin * 1000;
+	if (stmin >= 0xf1 && stmin <= 0xf9)
+		return (uint32_t) (stmin - 0xf0) * 100;
+	return 127000;
+}
+
+
+int myCANFastPacket::addIsoTp(uint32_t rx_id, uint32_t tx_id, bool ext/*=false*/)
+{
+	if (m_num_channels >= CAN_TP_CHANNELS)
+	{
+		my_error("CAN_TP_CHANNELS(%d) exceeded",CAN_TP_CHANNELS);
+		return -1;
+	}
+	channel_t *ch = &m_channels[m_num_channels];
+	memset(ch,0,sizeof(channel_t));
+	ch->rx_id = rx_id;
+	ch->tx_id = tx_id;
+	ch->flags = ext ? CAN_FRAME_EXT : 0;
+	return m_num_channels++;
+}
+
+
+myCANFastPacket::channel_t *myCANFastPacket::findChannel(uint32_t id, uint8_t flags, bool tx)
+{
+	for (int i=0; i<m_num_channels; i++)
+	{
+		channel_t *ch = &m_channels[i];
+		if ((tx ? ch->tx_id : ch->rx_id) == id && ch->flags == flags)
+			return ch;
+	}
+	return NULL;
+}
+
+
+bool myCANFastPacket::sendIsoTp(int channel, const uint8_t *data, int len)
+{
+	if (isoTpBusy(channel) || len <= 0 || len > CAN_TP_MAX_LEN)
+		return false;
+	channel_t *ch = &m_channels[channel];
+	ch->tx_data = data;
+	ch->tx_len = len;
+	ch->tx_pos = 0;
+	ch->tx_state = TP_TX_START;
+	return true;
+}
+
+
+bool myCANFastPacket::isoTpBusy(int channel)
+{
+	if (channel < 0 || channel >= m_num_channels)
+		return true;
+	return m_channels[channel].tx_state != TP_TX_IDLE;
+}
+
+
+const myCANMessage *myCANFastPacket::processIsoTp(int chan, const myCANFrame *frame)
+{
+	channel_t *ch = &m_channels[chan];
+	if (!frame->len)
+	{
+		m_dropped++;
+		return NULL;
+	}
+
+	uint8_t pci = frame->data[0];
+	uint32_t key = TP_KEY | chan;
+	session_t *s;
+
+	switch (pci >> 4)
+	{
+		case TP_SINGLE:
+		{
+			int len = pci & 0x0f;
+			if (!len || len >= frame->len)
+				break;
+			memset(&m_single,0,sizeof(m_single));
+			m_single.time = frame->time;
+			m_single.id = frame->id;
+			m_single.dest = CAN_N2K_BROADCAST;
+			m_single.len = len;
+			m_single.data = &frame->data[1];
+			return &m_single;
+		}
+
+		case TP_FIRST:
+		{
+			int len = ((pci & 0x0f) << 8) | frame->data[1];
+			if (frame->len < 8 || len < 8)
+				break;
+			s = findSession(key,0,frame->time);
+			if (s)
+			{
+				m_restarts++;
+				s->state = FP_FREE;
+			}
+			if (len > CAN_FP_MAX_LEN)
+			{
+				m_overflows++;
+				ch->fc_status = TP_FC_OVERFLOW;
+				ch->fc_pending = 1;
+				return NULL;
+			}
+			s = newSession(key,0,frame->time);
+			if (!s)
+				break;
+			s->len = len;
+			memcpy(s->data,&frame->data[2],6);
+			s->have = 6;
+			s->sn = 1;
+			s->block = 0;
+			ch->fc_status = TP_FC_CTS;
+			ch->fc_pending = 1;
+			return NULL;
+		}
+
+		case TP_CONSECUTIVE:
+		{
+			s = findSession(key,0,frame->time);
+			if (!s)
+				break;
+			int have = s->have;
+			int n = s->len - have;
+			if (n > 7)
+				n = 7;
+			if ((pci & 0x0f) != s->sn || frame->len < 1 + n)
+			{
+				s->state = FP_FREE;
+				break;
+			}
+			memcpy(&s->data[have],&frame->data[1],n);
+			s->have = have + n;
+			s->sn = (s->sn + 1) & 0x0f;
+			s->last = frame->time;
+
+			if (have + n < s->len)
+			{
+				if (CAN_TP_BLOCK_SIZE && ++s->block == CAN_TP_BLOCK_SIZE)
+				{
+					s->block = 0;
+					ch->fc_status = TP_FC_CTS;
+					ch->fc_pending = 1;
+				}
+				return NULL;
+			}
+
+			s->state = FP_HELD;
+			memset(&s->msg,0,sizeof(myCANMessage));
+			s->msg.time = frame->time;
+			s->msg.id = frame->id;
+			s->msg.dest = CAN_N2K_BROADCAST;
+			s->msg.len = s->len;
+			s->msg.data = s->data;
+			m_completed++;
+			return &s->msg;
+		}
+
+		case TP_FLOW:
+			flowReceived(ch,frame);
+			return NULL;
+	}
+
+	m_dropped++;
+	return NULL;
+}
+
+
+void myCANFastPacket::flowReceived(channel_t *ch, const myCANFrame *frame)
+{
+	if (ch->tx_state != TP_TX_WAIT || frame->len < 3)
+		return;
+	switch (frame->data[0] & 0x0f)
+	{
+		case TP_FC_CTS:
+			ch->tx_block_size = frame->data[1];
+			ch->tx_block = 0;
+			ch->tx_stmin = stminUs(frame->data[2]);
+			ch->tx_last = frame->time - ch->tx_stmin;	// the first may go at once
+			ch->tx_state = TP_TX_SEND;
+			break;
+		case TP_FC_WAIT:
+			ch->tx_last = frame->time;					// starts N_Bs again
+			break;
+		default:										// overflow, or invalid
+			ch->tx_state = TP_TX_IDLE;
+			m_tp_aborts++;
+			break;
+	}
+}
+
+
+void myCANFastPacket::initFrame(myCANFrame *frame, const channel_t *ch)
+{
+	frame->time = 0;
+	frame->id = ch->tx_id;
+	frame->flags = ch->flags;
+	frame->len = 8;
+	memset(frame->data,0xff,8);
+}
+
+
+bool myCANFastPacket::nextFrame(myCANFrame *frame, uint32_t now)
+{
+	// flow controls first, as the other side is waiting on them
+
+	for (int i=0; i<m_num_channels; i++)
+	{
+		channel_t *ch = &m_channels[i];
+		if (ch->fc_pending)
+		{
+			initFrame(frame,ch);
+			frame->data[0] = (TP_FLOW << 4) | ch->fc_status;
+			frame->data[1] = CAN_TP_BLOCK_SIZE;
+			frame->data[2] = CAN_TP_STMIN;
+			return true;
+		}
+	}
+
+	for (int i=0; i<m_num_channels; i++)
+	{
+		channel_t *ch = &m_channels[i];
+		int32_t elapsed = now - ch->tx_last;
+		if (ch->tx_state == TP_TX_WAIT && elapsed > (int32_t) TP_TIMEOUT_US)
+		{
+			ch->tx_state = TP_TX_IDLE;
+			m_tp_aborts++;
+		}
+		else if (ch->tx_state == TP_TX_START)
+		{
+			initFrame(frame,ch);
+			if (ch->tx_len <= 7)
+			{
+				frame->data[0] = (TP_SINGLE << 4) | ch->tx_len;
+				memcpy(&frame->data[1],ch->tx_data,ch->tx_len);
+			}
+			else
+			{
+				frame->data[0] = (TP_FIRST << 4) | (ch->tx_len >> 8);
+				frame->data[1] = ch->tx_len;
+				memcpy(&frame->data[2],ch->tx_data,6);
+			}
+			return true;
+		}
+		else if (ch->tx_state == TP_TX_SEND && elapsed >= (int32_t) ch->tx_stmin)
+		{
+			int n = ch->tx_len - ch->tx_pos;
+			if (n > 7)
+				n = 7;
+			initFrame(frame,ch);
+			frame->data[0] = (TP_CONSECUTIVE << 4) | ch->tx_sn;
+			memcpy(&frame->data[1],&ch->tx_data[ch->tx_pos],n);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void myCANFastPacket::sent(const myCANFrame *frame, uint32_t now)
+{
+	channel_t *ch = findChannel(frame->id,frame->flags & CAN_FRAME_EXT,true);
+	if (!ch)
+		return;
+	if ((frame->data[0] >> 4) == TP_FLOW)
+	{
+		ch->fc_pending = 0;
+		return;
+	}
+
+	ch->tx_last = now;
+	if (ch->tx_state == TP_TX_START)
+	{
+		if (ch->tx_len <= 7)
+		{
+			ch->tx_state = TP_TX_IDLE;
+			m_tp_sent++;
+			return;
+		}
+		ch->tx_pos = 6;
+		ch->tx_sn = 1;
+		ch->tx_state = TP_TX_WAIT;
+		return;
+	}
+
+	int n = ch->tx_len - ch->tx_pos;
+	ch->tx_pos += n > 7 ? 7 : n;
+	ch->tx_sn = (ch->tx_sn + 1) & 0x0f;
+	if (ch->tx_pos >= ch->tx_len)
+	{
+		ch->tx_state = TP_TX_IDLE;
+		m_tp_sent++;
+	}
+	else if (ch->tx_block_size && ++ch->tx_block == ch->tx_block_size)
+	{
+		ch->tx_block = 0;
+		ch->tx_state = TP_TX_WAIT;
+	}
+}
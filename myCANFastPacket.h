@@ -0,0 +1,277 @@
+//-------------------------------------------
+// myCANFastPacket.h
+//-------------------------------------------
+// NMEA2000 fast-packet, and ISO-TP, reassembly and segmentation.
+//
+// A fast packet carries up to 223 bytes of a PGN in up to 32
+// frames. The top 3 bits of the first data byte are a sequence id,
+// that changes with each message from a source, and the low 5 bits
+// count the frames. Frame 0 has the total length in the second byte,
+// and 6 bytes of data, and the rest have 7 bytes each.
+//
+// process() keeps a bounded pool of sessions, keyed by the id without
+// its priority bits, which is the source, PGN, and for PDU1, the
+// destination, along with the sequence id. Each frame is placed by
+// its frame counter, so frames may arrive in any order, and the
+// message completes when every frame up to its length has been seen.
+// A session that goes CAN_FP_TIMEOUT_MS without a frame is dropped,
+// as is one whose frame 0 arrives again. If the pool is full, the
+// oldest session still being assembled is evicted.
+//
+// A completed message is returned pointing at the session's own
+// buffer, without a copy, and the session is held until release().
+// Frames of PGNs that were not added with addPgn() are returned as
+// single frame messages, pointing at the frame's own data.
+//
+//		myCANFastPacket fp;
+//		fp.addPgn(129029);		// GNSS position
+//
+//		const myCANFrame *frames = can.peek(&n);
+//		for (int i=0; i<n; i++)
+//		{
+//			const myCANMessage *msg = fp.process(&frames[i]);
+//			if (msg)
+//			{
+//				handle(msg);
+//				fp.release(msg);
+//			}
+//		}
+//		can.consume(n);
+//
+// segment() splits a message into frames for myCANDriver::send(),
+// whose queue keeps frames with the same id in the order given.
+//
+// ISO-TP (ISO 15765-2), with normal addressing, runs on channels
+// added with addIsoTp(), each a pair of ids: the peer sends on rx_id,
+// and this node on tx_id, including its flow controls. A single
+// frame carries up to 7 bytes. A longer message starts with a first
+// frame, with the 12 bit length and 6 bytes, and the receiver answers
+// with a flow control, that gives the sender the block size, the
+// number of consecutive frames it may send before the next flow
+// control, and STmin, the time it must leave between them. Each
+// consecutive frame carries 7 bytes and a 4 bit sequence number.
+//
+// Received ISO-TP messages come from process() as fast packets do,
+// assembled in the same pool of sessions, one per channel, and held
+// until release(). They may be up to CAN_FP_MAX_LEN bytes long, and
+// a first frame for a longer one is answered with an overflow. As
+// ISO-TP frames come in order, a consecutive frame out of sequence
+// drops the message, as does CAN_TP_TIMEOUT_MS without one (N_Cr).
+// For an ISO-TP message, only the time, id, len and data are set.
+//
+// sendIsoTp() starts sending a message of up to CAN_TP_MAX_LEN bytes
+// from the caller's buffer, without a copy, and transmit() sends the
+// frames that are due, along with the flow controls the receiving
+// side owes, from loop(). The send is given up if a flow control does
+// not come within CAN_TP_TIMEOUT_MS (N_Bs), or reports an overflow.
+//
+//		int chan = fp.addIsoTp(0x7E8,0x7E0);
+//		fp.sendIsoTp(chan,request,len);
+//
+//		loop():
+//			... fp.process() as above ...
+//			fp.transmit(&can);
+
+#pragma once
+
+#include <Arduino.h>
+#include "myCANFrame.h"
+
+#ifndef CAN_FP_SESSIONS
+	#define CAN_FP_SESSIONS			8
+#endif
+#ifndef CAN_FP_MAX_PGNS
+	#define CAN_FP_MAX_PGNS			16
+#endif
+#ifndef CAN_FP_TIMEOUT_MS
+	#define CAN_FP_TIMEOUT_MS		750
+#endif
+
+#ifndef CAN_TP_CHANNELS
+	#define CAN_TP_CHANNELS			4
+#endif
+#ifndef CAN_TP_BLOCK_SIZE
+	#define CAN_TP_BLOCK_SIZE		8		// frames per flow control, 0 = all
+#endif
+#ifndef CAN_TP_STMIN
+	#define CAN_TP_STMIN			0		// ms asked of the sender between frames
+#endif
+#ifndef CAN_TP_TIMEOUT_MS
+	#define CAN_TP_TIMEOUT_MS		1000	// N_Bs and N_Cr
+#endif
+
+#define CAN_FP_MAX_LEN				223		// 6 + 31 * 7
+#define CAN_FP_MAX_FRAMES			32
+#define CAN_N2K_BROADCAST			255
+#define CAN_TP_MAX_LEN				4095
+
+
+typedef struct
+{
+	uint32_t time;			// micros() of the last frame
+	uint32_t id;			// of the last frame
+	uint32_t pgn;
+	uint8_t priority;
+	uint8_t source;
+	uint8_t dest;			// CAN_N2K_BROADCAST for PDU2
+	uint16_t len;
+	const uint8_t *data;
+} myCANMessage;
+
+
+class myCANFastPacket
+{
+public:
+
+	myCANFastPacket();
+
+	bool addPgn(uint32_t pgn);
+		// returns false if there are more than CAN_FP_MAX_PGNS
+	bool isFastPacket(uint32_t pgn);
+
+	const myCANMessage *process(const myCANFrame *frame);
+		// Returns a message when the frame completes a fast packet,
+		// or for an extended frame of any other PGN, otherwise NULL.
+		// The message stays valid until release(), or for a single
+		// frame, as long as the frame itself.
+	void release(const myCANMessage *msg);
+
+	void expire(uint32_t now);
+		// drops sessions that timed out as of micros() now;
+		// process() only notices them when it needs a session
+
+	int segment(uint32_t id, const uint8_t *data, int len, myCANFrame *frames, int max);
+		// Splits a message into frames with the next sequence id,
+		// and returns the number, or 0 if len or max are too small.
+		// The unused bytes of the last frame are 0xff.
+
+	static int numFrames(int len);
+	static uint32_t getPgn(uint32_t id);
+	static uint32_t makeId(int priority, uint32_t pgn, int source, int dest=CAN_N2K_BROADCAST);
+
+	// ISO-TP
+
+	int addIsoTp(uint32_t rx_id, uint32_t tx_id, bool ext=false);
+		// returns the channel, or -1 if there are more than CAN_TP_CHANNELS
+	bool sendIsoTp(int channel, const uint8_t *data, int len);
+		// Starts sending a message, whose data must stay valid until
+		// isoTpBusy() is false. Returns false if the channel is busy,
+		// or len is 0 or more than CAN_TP_MAX_LEN.
+	bool isoTpBusy(int channel);
+
+	bool nextFrame(myCANFrame *frame, uint32_t now);
+		// builds the next ISO-TP frame due as of micros() now, a flow
+		// control or a frame of a message, and returns false if none is
+	void sent(const myCANFrame *frame, uint32_t now);
+		// marks a frame from nextFrame() as sent
+
+	template <class DRIVER>
+	int transmit(DRIVER *can)
+		// sends the ISO-TP frames that are due, until the driver's
+		// queue is full, and returns the number of frames sent
+	{
+		uint32_t now = micros();
+		myCANFrame frame;
+		int n = 0;
+		while (nextFrame(&frame,now) && can->send(&frame))
+		{
+			sent(&frame,now);
+			n++;
+		}
+		return n;
+	}
+
+	uint32_t getCompleted()		{ return m_completed; }
+	uint32_t getTimeouts()		{ return m_timeouts; }
+	uint32_t getRestarts()		{ return m_restarts; }
+		// sessions dropped because frame 0 arrived again
+	uint32_t getEvictions()		{ return m_evictions; }
+	uint32_t getDropped()		{ return m_dropped; }
+		// frames that did not fit a session, or found none free
+	uint32_t getOverflows()		{ return m_overflows; }
+		// ISO-TP messages received that were too long
+	uint32_t getIsoTpSent()		{ return m_tp_sent; }
+	uint32_t getIsoTpAborts()	{ return m_tp_aborts; }
+		// sends given up for a missing flow control, or an overflow
+
+
+private:
+
+	typedef enum
+	{
+		FP_FREE,
+		FP_BUSY,		// being assembled
+		FP_HELD,		// delivered, until release()
+	} state_t;
+
+	typedef struct
+	{
+		uint8_t state;
+		uint8_t seq;
+		int16_t len;		// -1 until frame 0 arrives
+		uint32_t key;		// id without the priority
+		uint32_t last;		// micros() of the last frame
+		uint32_t have;		// bit per frame counter, or ISO-TP bytes
+		uint8_t sn;			// ISO-TP sequence number expected
+		uint8_t block;		// ISO-TP frames since the flow control
+		myCANMessage msg;
+		uint8_t data[CAN_FP_MAX_LEN];
+	} session_t;
+
+	typedef enum
+	{
+		TP_TX_IDLE,
+		TP_TX_START,	// the single or first frame is due
+		TP_TX_WAIT,		// for a flow control
+		TP_TX_SEND,		// consecutive frames
+	} tx_state_t;
+
+	typedef struct
+	{
+		uint32_t rx_id;
+		uint32_t tx_id;
+		uint8_t flags;			// CAN_FRAME_EXT or 0
+		bool fc_pending;		// a flow control is owed
+		uint8_t fc_status;
+
+		uint8_t tx_state;
+		uint8_t tx_sn;
+		uint8_t tx_block_size;	// from the receiver, 0 = no limit
+		uint8_t tx_block;		// frames sent in the block
+		uint32_t tx_stmin;		// us
+		uint32_t tx_last;		// micros() of the last frame
+		const uint8_t *tx_data;
+		uint16_t tx_len;
+		uint16_t tx_pos;
+	} channel_t;
+
+	int m_num_pgns;
+	uint32_t m_pgns[CAN_FP_MAX_PGNS];
+
+	session_t m_sessions[CAN_FP_SESSIONS];
+	myCANMessage m_single;
+	uint8_t m_tx_seq;
+
+	int m_num_channels;
+	channel_t m_channels[CAN_TP_CHANNELS];
+
+	uint32_t m_completed;
+	uint32_t m_timeouts;
+	uint32_t m_restarts;
+	uint32_t m_evictions;
+	uint32_t m_dropped;
+	uint32_t m_overflows;
+	uint32_t m_tp_sent;
+	uint32_t m_tp_aborts;
+
+	static uint32_t sessionTimeout(const session_t *s);
+	session_t *findSession(uint32_t key, uint8_t seq, uint32_t time);
+	session_t *newSession(uint32_t key, uint8_t seq, uint32_t time);
+	void setMessage(myCANMessage *msg, const myCANFrame *frame);
+
+	channel_t *findChannel(uint32_t id, uint8_t flags, bool tx);
+	const myCANMessage *processIsoTp(int chan, const myCANFrame *frame);
+	void flowReceived(channel_t *ch, const myCANFrame *frame);
+	void initFrame(myCANFrame *frame, const channel_t *ch);
+
+};
@@ -0,0 +1,375 @@
+//-------------------------------------------
+// myCANFilter.cpp
+//-------------------------------------------
+
+#include "myCANFilter.h"
+#include <myDebug.h>
+
+#define STD_FULL_MASK	0x000007FF
+#define EXT_FULL_MASK	0x1FFFFFFF
+
+// NMEA2000 29 bit ids: priority(3) EDP(1) DP(1) PF(8) PS(8) SA(8)
+
+#define N2K_PDU2_MASK	0x03FFFF00		// EDP, DP, PF, PS
+#define N2K_PDU1_MASK	0x03FF0000		// EDP, DP, PF
+
+static const int buffer_filters[CAN_NUM_MASKS] = { 2, 4 };
+static const int buffer_first[CAN_NUM_MASKS] = { 0, 2 };
+
+
+myCANFilter::myCANFilter()
+{
+	clear();
+}
+
+
+void myCANFilter::clear()
+{
+	m_num = 0;
+	compile();
+	m_cal_start = 0;
+	m_cal_ms = 0;
+	m_cal_frames = 0;
+	m_cal_hw = 0;
+	m_cal_sw = 0;
+}
+
+
+bool myCANFilter::add(uint32_t value, uint32_t mask, bool ext)
+{
+	if (m_num >= CAN_MAX_FILTER_IDS)
+	{
+		my_error("CAN_MAX_FILTER_IDS(%d) exceeded",CAN_MAX_FILTER_IDS);
+		return false;
+	}
+	mask &= ext ? EXT_FULL_MASK : STD_FULL_MASK;
+	entry_t *entry = &m_entries[m_num++];
+	entry->value = value & mask;
+	entry->mask = mask;
+	entry->ext = ext;
+	return true;
+}
+
+
+void myCANFilter::getId(int i, uint32_t *value, uint32_t *mask, bool *ext)
+{
+	const entry_t *entry = &m_entries[i];
+	*value = entry->value;
+	*mask = entry->mask;
+	*ext = entry->ext;
+}
+
+
+bool myCANFilter::addId(uint32_t id, bool ext/*=false*/)
+{
+	return add(id,EXT_FULL_MASK,ext);
+}
+
+
+bool myCANFilter::addPgn(uint32_t pgn)
+{
+	uint8_t pf = (pgn >> 8) & 0xff;
+	return add(pgn << 8,pf < 240 ? N2K_PDU1_MASK : N2K_PDU2_MASK,true);
+}
+
+
+//-----------------------------------
+// compiler
+//-----------------------------------
+
+static int bitCount(uint32_t v)
+{
+	int n = 0;
+	while (v)
+	{
+		v &= v - 1;
+		n++;
+	}
+	return n;
+}
+
+
+static int countPatterns(const uint32_t *values, int n, uint32_t mask, uint32_t *patterns)
+	// the distinct values & mask
+{
+	int num = 0;
+	for (int i=0; i<n; i++)
+	{
+		uint32_t p = values[i] & mask;
+		int j = 0;
+		while (j < num && patterns[j] != p)
+			j++;
+		if (j == num)
+			patterns[num++] = p;
+	}
+	return num;
+}
+
+
+uint64_t myCANFilter::reduce(const entry_t **group, int n, int k, uint32_t *mask, uint32_t *patterns, int *num_patterns)
+	// Finds a mask for the group that needs no more than k filters,
+	// and returns the size of the id space the filters then accept.
+{
+	*num_patterns = 0;
+	if (!n)
+		return 0;
+
+	uint32_t values[CAN_MAX_FILTER_IDS];
+	uint32_t m = group[0]->ext ? EXT_FULL_MASK : STD_FULL_MASK;
+	for (int i=0; i<n; i++)
+	{
+		m &= group[i]->mask;
+		values[i] = group[i]->value;
+	}
+
+	uint32_t tmp[CAN_MAX_FILTER_IDS];
+	int num = countPatterns(values,n,m,patterns);
+	while (num > k)
+	{
+		// clear the mask bit that merges the most patterns
+
+		int best_bit = -1;
+		int best_num = num;
+		for (int bit=0; bit<29; bit++)
+		{
+			if (!(m & (1UL << bit)))
+				continue;
+			int c = countPatterns(values,n,m & ~(1UL << bit),tmp);
+			if (best_bit < 0 || c < best_num)
+			{
+				best_bit = bit;
+				best_num = c;
+			}
+		}
+		m &= ~(1UL << best_bit);
+		num = countPatterns(values,n,m,patterns);
+	}
+
+	*mask = m;
+	*num_patterns = num;
+	int width = group[0]->ext ? 29 : 11;
+	return (uint64_t) num << (width - bitCount(m));
+}
+
+
+void myCANFilter::install(int buffer, const entry_t **group, int n)
+{
+	uint32_t patterns[CAN_MAX_FILTER_IDS];
+	int num;
+	uint32_t mask = 0;
+	reduce(group,n,buffer_filters[buffer],&mask,patterns,&num);
+
+	bool ext = group[0]->ext;
+	m_masks[buffer] = mask;
+	m_mask_ext[buffer] = ext;
+	for (int i=0; i<buffer_filters[buffer]; i++)
+	{
+		// unused filters repeat the first one
+		int f = buffer_first[buffer] + i;
+		m_filters[f] = patterns[i < num ? i : 0];
+		m_filter_ext[f] = ext;
+	}
+}
+
+
+void myCANFilter::compile()
+{
+	memset(m_masks,0,sizeof(m_masks));
+	memset(m_mask_ext,0,sizeof(m_mask_ext));
+	memset(m_filters,0,sizeof(m_filters));
+	memset(m_filter_ext,0,sizeof(m_filter_ext));
+	if (!m_num)
+		return;		// masks of 0 accept everything
+
+	// sort the entries by value, so that similar ids are adjacent,
+	// standard ids before extended ones
+
+	const entry_t *sorted[CAN_MAX_FILTER_IDS];
+	int num_std = 0;
+	for (int i=0; i<m_num; i++)
+		if (!m_entries[i].ext)
+			sorted[num_std++] = &m_entries[i];
+	int n = num_std;
+	for (int i=0; i<m_num; i++)
+		if (m_entries[i].ext)
+			sorted[n++] = &m_entries[i];
+	for (int i=1; i<m_num; i++)
+	{
+		const entry_t *e = sorted[i];
+		int j = i;
+		while (j > 0 && sorted[j-1]->ext == e->ext && sorted[j-1]->value > e->value)
+		{
+			sorted[j] = sorted[j-1];
+			j--;
+		}
+		sorted[j] = e;
+	}
+
+	// Try splitting the sorted list at each point, with either half
+	// in RXB0, keeping standard and extended ids in separate buffers.
+
+	uint32_t mask;
+	uint32_t patterns[CAN_MAX_FILTER_IDS];
+	int num;
+	int best_split = -1;
+	bool best_swap = 0;
+	uint64_t best_cost = 0;
+
+	for (int split=0; split<=m_num; split++)
+	{
+		if (num_std && num_std < m_num && split != num_std)
+			continue;
+		const entry_t **lo = sorted;
+		const entry_t **hi = &sorted[split];
+		int n_lo = split;
+		int n_hi = m_num - split;
+
+		for (int swap=0; swap<2; swap++)
+		{
+			const entry_t **g0 = swap ? hi : lo;
+			const entry_t **g1 = swap ? lo : hi;
+			int n0 = swap ? n_hi : n_lo;
+			int n1 = swap ? n_lo : n_hi;
+			uint64_t cost =
+				reduce(g0,n0,buffer_filters[0],&mask,patterns,&num) +
+				reduce(g1,n1,buffer_filters[1],&mask,patterns,&num);
+			if (best_split < 0 || cost < best_cost)
+			{
+				best_split = split;
+				best_swap = swap;
+				best_cost = cost;
+			}
+		}
+	}
+
+	const entry_t **lo = sorted;
+	const entry_t **hi = &sorted[best_split];
+	int n_lo = best_split;
+	int n_hi = m_num - best_split;
+	const entry_t **g0 = best_swap ? hi : lo;
+	const entry_t **g1 = best_swap ? lo : hi;
+	int n0 = best_swap ? n_hi : n_lo;
+	int n1 = best_swap ? n_lo : n_hi;
+
+	// an empty buffer copies the other one
+
+	if (n0)
+		install(0,g0,n0);
+	if (n1)
+		install(1,g1,n1);
+	if (!n0)
+	{
+		m_masks[0] = m_masks[1];
+		m_mask_ext[0] = m_mask_ext[1];
+		m_filters[0] = m_filters[1] = m_filters[2];
+		m_filter_ext[0] = m_filter_ext[1] = m_filter_ext[2];
+	}
+	if (!n1)
+	{
+		m_masks[1] = m_masks[0];
+		m_mask_ext[1] = m_mask_ext[0];
+		for (int f=2; f<CAN_NUM_FILTERS; f++)
+		{
+			m_filters[f] = m_filters[0];
+			m_filter_ext[f] = m_filter_ext[0];
+		}
+	}
+}
+
+
+//-----------------------------------
+// matching
+//-----------------------------------
+
+bool myCANFilter::hwAccepts(const myCANFrame *frame)
+{
+	if (!m_num)
+		return true;
+	bool ext = frame->flags & CAN_FRAME_EXT;
+	for (int b=0; b<CAN_NUM_MASKS; b++)
+	{
+		uint32_t mask = m_masks[b];
+		for (int i=0; i<buffer_filters[b]; i++)
+		{
+			int f = buffer_first[b] + i;
+			if (m_filter_ext[f] == ext &&
+				(frame->id & mask) == (m_filters[f] & mask))
+				return true;
+		}
+	}
+	return false;
+}
+
+
+bool myCANFilter::match(const myCANFrame *frame)
+{
+	if (!m_num)
+		return true;
+	bool ext = frame->flags & CAN_FRAME_EXT;
+	for (int i=0; i<m_num; i++)
+	{
+		const entry_t *e = &m_entries[i];
+		if (e->ext == ext && (frame->id & e->mask) == e->value)
+			return true;
+	}
+	return false;
+}
+
+
+//-----------------------------------
+// calibration
+//-----------------------------------
+
+void myCANFilter::startCalibration()
+{
+	m_cal_start = millis();
+	m_cal_ms = 0;
+	m_cal_frames = 0;
+	m_cal_hw = 0;
+	m_cal_sw = 0;
+}
+
+
+void myCANFilter::calibrate(const myCANFrame *frame)
+{
+	m_cal_frames++;
+	if (hwAccepts(frame))
+	{
+		m_cal_hw++;
+		if (match(frame))
+			m_cal_sw++;
+	}
+}
+
+
+void myCANFilter::endCalibration()
+{
+	m_cal_ms = millis() - m_cal_start;
+}
+
+
+void myCANFilter::report()
+{
+	display(0,"myCANFilter: %d ids",m_num);
+	for (int b=0; b<CAN_NUM_MASKS; b++)
+	{
+		int f = buffer_first[b];
+		display(0,"    RXB%d %s mask(0x%08x) filters(0x%08x 0x%08x)",
+			b,m_mask_ext[b] ? "ext" : "std",m_masks[b],m_filters[f],m_filters[f+1]);
+		if (buffer_filters[b] > 2)
+			display(0,"                             filters(0x%08x 0x%08x)",
+				m_filters[f+2],m_filters[f+3]);
+	}
+	if (!m_cal_ms)
+		return;
+
+	uint32_t hw_rejected = m_cal_frames - m_cal_hw;
+	uint32_t sw_rejected = m_cal_hw - m_cal_sw;
+	display(0,"    %u frames in %ums (%u/s)",
+		m_cal_frames,m_cal_ms,m_cal_frames * 1000 / m_cal_ms);
+	display(0,"    hardware rejects %u (%u%%), software rejects %u, accepted %u",
+		hw_rejected,
+		m_cal_frames ? hw_rejected * 100 / m_cal_frames : 0,
+		sw_rejected,
+		m_cal_sw);
+}
@@ -0,0 +1,111 @@
+//-------------------------------------------
+// myCANFilter.h
+//-------------------------------------------
+// Compiles a declarative set of wanted CAN ids, and NMEA2000
+// PGNs, into the 2 masks and 6 acceptance filters of an MCP2515,
+// with an exact software filter for whatever the hardware
+// filters let through that was not asked for.
+//
+// The MCP2515 has two receive buffers. RXB0 has mask 0 and
+// filters 0 and 1, and RXB1 has mask 1 and filters 2 to 5.
+// Every filter of a buffer shares its mask, and each filter
+// matches either standard or extended frames. compile() splits
+// the wanted ids between the buffers and, if there are more
+// distinct patterns than filters, clears the mask bits that
+// merge the most of them, looking for the split that lets the
+// least extra traffic through. That is a heuristic, not an
+// optimum, but a good one for the handfuls of ids and PGNs in
+// practice.
+//
+// A PGN is matched from any source address. PDU1 PGNs (PF < 240)
+// are also matched for any destination address.
+//
+// myCANDriver::setFilters() installs the filters, optionally after
+// a calibration window with the hardware filters open, during which
+// every frame is counted against what the hardware filters and the
+// software filter would accept. report() then shows how much of the
+// traffic the hardware rejects.
+
+#pragma once
+
+#include <Arduino.h>
+#include "myCANFrame.h"
+
+#ifndef CAN_MAX_FILTER_IDS
+	#define CAN_MAX_FILTER_IDS		16
+#endif
+
+#define CAN_NUM_MASKS				2
+#define CAN_NUM_FILTERS				6
+
+
+class myCANFilter
+{
+public:
+
+	myCANFilter();
+
+	void clear();
+		// back to accepting everything
+
+	bool addId(uint32_t id, bool ext=false);
+	bool addPgn(uint32_t pgn);
+		// an NMEA2000 PGN from any source
+	bool add(uint32_t value, uint32_t mask, bool ext);
+		// frames whose (id & mask) == value
+		// all return false if there are too many ids
+
+	void compile();
+		// computes the masks and filters
+
+	bool isOpen()  { return !m_num; }
+		// true if there is nothing to filter on
+	bool hwAccepts(const myCANFrame *frame);
+		// as the compiled hardware filters would
+	bool match(const myCANFrame *frame);
+		// the exact software filter
+
+	uint32_t getMask(int i)  		{ return m_masks[i]; }
+	bool getMaskExt(int i)  		{ return m_mask_ext[i]; }
+	uint32_t getFilter(int i)  		{ return m_filters[i]; }
+	bool getFilterExt(int i)  		{ return m_filter_ext[i]; }
+
+	int getNumIds()  { return m_num; }
+	void getId(int i, uint32_t *value, uint32_t *mask, bool *ext);
+		// as added, for controllers that filter exactly
+
+	// calibration statistics
+
+	void startCalibration();
+	void calibrate(const myCANFrame *frame);
+	void endCalibration();
+	void report();
+
+
+private:
+
+	typedef struct
+	{
+		uint32_t value;
+		uint32_t mask;
+		bool ext;
+	} entry_t;
+
+	int m_num;
+	entry_t m_entries[CAN_MAX_FILTER_IDS];
+
+	uint32_t m_masks[CAN_NUM_MASKS];
+	bool m_mask_ext[CAN_NUM_MASKS];
+	uint32_t m_filters[CAN_NUM_FILTERS];
+	bool m_filter_ext[CAN_NUM_FILTERS];
+
+	uint32_t m_cal_start;
+	uint32_t m_cal_ms;
+	uint32_t m_cal_frames;
+	uint32_t m_cal_hw;
+	uint32_t m_cal_sw;
+
+	uint64_t reduce(const entry_t **group, int n, int k, uint32_t *mask, uint32_t *patterns, int *num_patterns);
+	void install(int buffer, const entry_t **group, int n);
+
+};
@@ -0,0 +1,95 @@
+//-------------------------------------------
+// myCANFrame.h
+//-------------------------------------------
+// The CAN frame used by myCANDriver, its backends, and the
+// filter and fast-packet layers, and the lock-free ring the
+// frames are passed through.
+
+#pragma once
+
+#include <Arduino.h>
+
+#define CAN_FRAME_EXT				0x01	// 29 bit id
+#define CAN_FRAME_RTR				0x02	// remote request
+
+
+typedef struct
+{
+	uint32_t time;			// micros() of the INT edge, or when read
+	uint32_t id;			// 11 or 29 bits, without flags
+	uint8_t len;			// 0..8
+	uint8_t flags;			// CAN_FRAME_EXT | CAN_FRAME_RTR
+	uint8_t data[8];
+} myCANFrame;
+
+
+template <int SIZE>
+class myCANRing
+	// Lock-free for a single producer and a single consumer,
+	// which may be in different tasks or on different cores.
+	// The indexes run freely and are masked when used.
+{
+public:
+
+	myCANRing() : m_head(0), m_tail(0) {}
+
+	int count()		{ return m_head - m_tail; }
+	bool full()		{ return m_head - m_tail >= SIZE; }
+
+	// producer
+
+	bool push(const myCANFrame *frame)
+	{
+		uint32_t head = m_head;
+		if (head - m_tail >= SIZE)
+			return false;
+		m_frames[head & (SIZE - 1)] = *frame;
+		__sync_synchronize();
+		m_head = head + 1;
+		return true;
+	}
+
+	// consumer
+
+	int pop(myCANFrame *frames, int max)
+	{
+		uint32_t tail = m_tail;
+		int n = m_head - tail;
+		if (n > max)
+			n = max;
+		__sync_synchronize();
+		for (int i=0; i<n; i++)
+			frames[i] = m_frames[(tail + i) & (SIZE - 1)];
+		__sync_synchronize();
+		m_tail = tail + n;
+		return n;
+	}
+
+	const myCANFrame *peek(int *n)
+		// returns the oldest frames in place, and sets n to the number
+		// of them that are contiguous in the ring; call consume() when done
+	{
+		uint32_t tail = m_tail;
+		int avail = m_head - tail;
+		int to_end = SIZE - (tail & (SIZE - 1));
+		*n = avail < to_end ? avail : to_end;
+		__sync_synchronize();
+		return &m_frames[tail & (SIZE - 1)];
+	}
+
+	void consume(int n)
+	{
+		__sync_synchronize();
+		m_tail = m_tail + n;
+	}
+
+
+private:
+
+	static_assert((SIZE & (SIZE - 1)) == 0,"ring SIZE must be a power of 2");
+
+	volatile uint32_t m_head;	// written only by the producer
+	volatile uint32_t m_tail;	// written only by the consumer
+	myCANFrame m_frames[SIZE];
+
+};
@@ -0,0 +1,357 @@
+//-------------------------------------------
+// myCANMcp2515.cpp
+//-------------------------------------------
+
+#include "myCANMcp2515.h"
+#include "myCANFilter.h"
+#include <myDebug.h>
+
+// MCP2515 instructions and registers used directly
+
+#define MCP_READ			0x03
+#define MCP_BITMOD			0x05
+#define MCP_READ_RX0		0x90	// READ RX BUFFER from RXB0SIDH
+#define MCP_READ_RX1		0x94	// READ RX BUFFER from RXB1SIDH
+#define MCP_READ_STATUS		0xA0
+
+#define MCP_TEC				0x1C	// followed by REC
+#define MCP_CANINTE			0x2B
+#define MCP_CANINTF			0x2C	// followed by EFLG
+#define MCP_EFLG			0x2D
+
+#define TXB_ABTF			0x40
+#define TXB_TXREQ			0x08
+#define TXB_TXP				0x03
+
+#define SIDL_SRR			0x10
+#define SIDL_IDE			0x08
+#define DLC_RTR				0x40
+
+#define FRAME_REGS			13		// SIDH, SIDL, EID8, EID0, DLC, and D0..D7
+
+static const uint8_t txb_ctrl[CAN_MAX_TX_SLOTS] = { 0x30, 0x40, 0x50 };
+static const uint8_t txb_int[CAN_MAX_TX_SLOTS] = {
+	MCP2515::CANINTF_TX0IF,
+	MCP2515::CANINTF_TX1IF,
+	MCP2515::CANINTF_TX2IF };
+static const uint8_t txb_load[CAN_MAX_TX_SLOTS] = { 0x40, 0x42, 0x44 };
+	// LOAD TX BUFFER from TXBnSIDH
+static const uint8_t txb_rts[CAN_MAX_TX_SLOTS] = { 0x81, 0x82, 0x84 };
+static const uint8_t status_tx[CAN_MAX_TX_SLOTS] = { 0x08, 0x20, 0x80 };
+	// TXnIF in the READ STATUS byte, whose low bits are RX0IF and RX1IF
+	// as in CANINTF
+
+static const struct
+{
+	uint32_t bitrate;
+	CAN_SPEED speed;
+} speeds[] =
+{
+	{ 1000000,	CAN_1000KBPS },
+	{ 500000,	CAN_500KBPS },
+	{ 250000,	CAN_250KBPS },
+	{ 200000,	CAN_200KBPS },
+	{ 125000,	CAN_125KBPS },
+	{ 100000,	CAN_100KBPS },
+	{ 50000,	CAN_50KBPS },
+	{ 20000,	CAN_20KBPS },
+	{ 10000,	CAN_10KBPS },
+	{ 5000,		CAN_5KBPS },
+};
+
+
+myCANMcp2515::myCANMcp2515(int cs_pin, SPIClass *spi/*=NULL*/, CAN_CLOCK clock/*=MCP_8MHZ*/) :
+	m_cs_pin(cs_pin),
+	m_spi(spi ? spi : &SPI),
+	m_mcp(cs_pin,CAN_SPI_CLOCK,m_spi),
+	m_clock(clock),
+	m_irq(0),
+	m_overflows(0),
+	m_spi_transactions(0),
+	m_spi_bytes(0)
+{}
+
+
+bool myCANMcp2515::begin(uint32_t bitrate)
+{
+	int i = 0;
+	int num = sizeof(speeds) / sizeof(speeds[0]);
+	while (i < num && speeds[i].bitrate != bitrate)
+		i++;
+	if (i == num)
+	{
+		my_error("myCANMcp2515::begin() unsupported bitrate %d",bitrate);
+		return false;
+	}
+
+	MCP2515::ERROR err = m_mcp.reset();
+	if (err == MCP2515::ERROR_OK)
+		err = m_mcp.setBitrate(speeds[i].speed,m_clock);
+	if (err == MCP2515::ERROR_OK)
+		err = m_mcp.setNormalMode();
+	if (err != MCP2515::ERROR_OK)
+	{
+		my_error("myCANMcp2515::begin() err=%d",err);
+		return false;
+	}
+
+	// reset() enables only the RX and error interrupts
+
+	uint8_t tx_ie = txb_int[0] | txb_int[1] | txb_int[2];
+	modifyReg(MCP_CANINTE,tx_ie,tx_ie);
+	return true;
+}
+
+
+bool myCANMcp2515::setFilters(myCANFilter *filter)
+	// the library puts the chip in config mode to set them
+{
+	static myCANFilter open_filter;
+	if (!filter)
+		filter = &open_filter;
+
+	MCP2515::ERROR err = MCP2515::ERROR_OK;
+	for (int i=0; i<CAN_NUM_MASKS && err == MCP2515::ERROR_OK; i++)
+		err = m_mcp.setFilterMask((MCP2515::MASK) i,
+			filter->getMaskExt(i),filter->getMask(i));
+	for (int i=0; i<CAN_NUM_FILTERS && err == MCP2515::ERROR_OK; i++)
+		err = m_mcp.setFilter((MCP2515::RXF) i,
+			filter->getFilterExt(i),filter->getFilter(i));
+	if (err == MCP2515::ERROR_OK)
+		err = m_mcp.setNormalMode();
+	if (err != MCP2515::ERROR_OK)
+	{
+		my_error("myCANMcp2515::setFilters() err=%d",err);
+		return false;
+	}
+	return true;
+}
+
+
+void myCANMcp2515::handleErrors()
+	// the library enables ERRIF and MERRF, which also hold INT low
+{
+	uint8_t regs[2];
+	readRegs(MCP_CANINTF,regs,2);
+	if (!(regs[0] & (MCP2515::CANINTF_ERRIF | MCP2515::CANINTF_MERRF)))
+		return;
+
+	uint8_t ovr = MCP2515::EFLG_RX0OVR | MCP2515::EFLG_RX1OVR;
+	if (regs[1] & ovr)
+	{
+		m_overflows++;
+		modifyReg(MCP_EFLG,ovr,0);
+	}
+	modifyReg(MCP_CANINTF,MCP2515::CANINTF_ERRIF | MCP2515::CANINTF_MERRF,0);
+}
+
+
+void myCANMcp2515::getErrorCounts(uint8_t *tec, uint8_t *rec, uint8_t *flags)
+{
+	uint8_t regs[2];
+	readRegs(MCP_TEC,regs,2);
+	*tec = regs[0];
+	*rec = regs[1];
+	*flags = readReg(MCP_EFLG);
+}
+
+
+uint8_t myCANMcp2515::getEvents()
+	// READ STATUS gives the RX and TX flags in one byte, but
+	// not the error flags, which are checked once the frames
+	// waiting have been read
+{
+	uint8_t status = quickRead(MCP_READ_STATUS);
+
+	uint8_t events = 0;
+	m_irq = status & (MCP2515::CANINTF_RX0IF | MCP2515::CANINTF_RX1IF);
+	if (m_irq)
+		events |= CAN_EVENT_RX;
+	else
+		handleErrors();
+
+	uint8_t tx_done = 0;
+	for (int b=0; b<CAN_MAX_TX_SLOTS; b++)
+	{
+		if (status & status_tx[b])
+		{
+			events |= CAN_EVENT_TX0 << b;
+			tx_done |= txb_int[b];
+		}
+	}
+	if (tx_done)
+		modifyReg(MCP_CANINTF,tx_done,0);
+	return events;
+}
+
+
+bool myCANMcp2515::read(myCANFrame *frame)
+	// RXB0 first, as it holds the older, or higher priority, frame,
+	// in one READ RX BUFFER burst, which clears RXnIF as CS goes high
+{
+	uint8_t instr;
+	if (m_irq & MCP2515::CANINTF_RX0IF)
+	{
+		instr = MCP_READ_RX0;
+		m_irq &= ~MCP2515::CANINTF_RX0IF;
+	}
+	else if (m_irq & MCP2515::CANINTF_RX1IF)
+	{
+		instr = MCP_READ_RX1;
+		m_irq &= ~MCP2515::CANINTF_RX1IF;
+	}
+	else
+		return false;
+
+	uint8_t regs[FRAME_REGS];
+	memset(regs,0,FRAME_REGS);
+	select();
+	m_spi->transfer(instr);
+	m_spi->transfer(regs,FRAME_REGS);
+	deselect(1 + FRAME_REGS);
+
+	uint32_t id = (regs[0] << 3) | (regs[1] >> 5);
+	if (regs[1] & SIDL_IDE)
+	{
+		id = (id << 18) | ((regs[1] & 0x03) << 16) | (regs[2] << 8) | regs[3];
+		frame->flags = CAN_FRAME_EXT | (regs[4] & DLC_RTR ? CAN_FRAME_RTR : 0);
+	}
+	else
+		frame->flags = regs[1] & SIDL_SRR ? CAN_FRAME_RTR : 0;
+	frame->id = id;
+	frame->len = (regs[4] & 0x0f) > 8 ? 8 : regs[4] & 0x0f;
+	memcpy(frame->data,&regs[5],8);
+	return true;
+}
+
+
+void myCANMcp2515::load(int slot, const myCANFrame *frame)
+	// one LOAD TX BUFFER burst, and the one byte RTS
+{
+	uint8_t regs[FRAME_REGS];
+	uint32_t id = frame->id;
+	if (frame->flags & CAN_FRAME_EXT)
+	{
+		regs[0] = id >> 21;
+		regs[1] = ((id >> 13) & 0xe0) | SIDL_IDE | ((id >> 16) & 0x03);
+		regs[2] = id >> 8;
+		regs[3] = id;
+	}
+	else
+	{
+		regs[0] = id >> 3;
+		regs[1] = (id & 0x07) << 5;
+		regs[2] = 0;
+		regs[3] = 0;
+	}
+	regs[4] = (frame->len > 8 ? 8 : frame->len) | (frame->flags & CAN_FRAME_RTR ? DLC_RTR : 0);
+	memcpy(&regs[5],frame->data,8);
+
+	select();
+	m_spi->transfer(txb_load[slot]);
+	m_spi->transfer(regs,FRAME_REGS);
+	deselect(1 + FRAME_REGS);
+
+	quickWrite(txb_rts[slot]);
+}
+
+
+void myCANMcp2515::setRank(int slot, int rank)
+	// the chip otherwise favors the highest numbered buffer
+{
+	modifyReg(txb_ctrl[slot],TXB_TXP,rank);
+}
+
+
+bool myCANMcp2515::abort(int slot)
+{
+	modifyReg(txb_ctrl[slot],TXB_TXREQ,0);
+	return true;
+}
+
+
+bool myCANMcp2515::aborted(int slot)
+	// If it was already on the bus it still goes out,
+	// and sets TXnIF, which getEvents() reports.
+{
+	uint8_t ctrl = readReg(txb_ctrl[slot]);
+	return !(ctrl & TXB_TXREQ) && (ctrl & TXB_ABTF);
+}
+
+
+//-----------------------------------
+// direct register access
+//-----------------------------------
+
+void myCANMcp2515::getSpiCounts(uint32_t *transactions, uint32_t *bytes)
+{
+	*transactions = m_spi_transactions;
+	*bytes = m_spi_bytes;
+}
+
+
+void myCANMcp2515::select()
+{
+	m_spi->beginTransaction(SPISettings(CAN_SPI_CLOCK,MSBFIRST,SPI_MODE0));
+	digitalWrite(m_cs_pin,LOW);
+}
+
+
+void myCANMcp2515::deselect(int bytes)
+{
+	digitalWrite(m_cs_pin,HIGH);
+	m_spi->endTransaction();
+	m_spi_transactions++;
+	m_spi_bytes += bytes;
+}
+
+
+uint8_t myCANMcp2515::quickRead(uint8_t instr)
+	// READ STATUS and RX STATUS
+{
+	select();
+	m_spi->transfer(instr);
+	uint8_t value = m_spi->transfer(0x00);
+	deselect(2);
+	return value;
+}
+
+
+void myCANMcp2515::quickWrite(uint8_t instr)
+	// RTS
+{
+	select();
+	m_spi->transfer(instr);
+	deselect(1);
+}
+
+
+uint8_t myCANMcp2515::readReg(uint8_t reg)
+{
+	uint8_t value;
+	readRegs(reg,&value,1);
+	return value;
+}
+
+
+void myCANMcp2515::readRegs(uint8_t reg, uint8_t *values, int num)
+	// the address increments through consecutive registers
+{
+	select();
+	m_spi->transfer(MCP_READ);
+	m_spi->transfer(reg);
+	for (int i=0; i<num; i++)
+		values[i] = m_spi->transfer(0x00);
+	deselect(2 + num);
+}
+
+
+void myCANMcp2515::modifyReg(uint8_t reg, uint8_t mask, uint8_t value)
+{
+	select();
+	m_spi->transfer(MCP_BITMOD);
+	m_spi->transfer(reg);
+	m_spi->transfer(mask);
+	m_spi->transfer(value);
+	deselect(4);
+}
@@ -0,0 +1,76 @@
+//-------------------------------------------
+// myCANMcp2515.h
+//-------------------------------------------
+// myCANBackend for an MCP2515 using the
+// github/autowp/arduino-mcp2515 library.
+//
+// The backend owns the library's MCP2515 object, on the given CS
+// pin and SPI bus, the default SPI if NULL. All three TX buffers
+// are used, ranked by their TXP bits, with the TX interrupts
+// enabled, and aborts. Those need registers the library does not
+// expose, which are reached directly on the same pin and bus.
+//
+// The frame path does not go through the library at all. Each
+// frame is read with one READ RX BUFFER burst, that also clears
+// its RXnIF, and sent with one LOAD TX BUFFER burst and a one byte
+// RTS, where the library takes three and four transactions, and
+// getEvents() uses the two byte READ STATUS. getSpiCounts() gives
+// the transactions and bytes, so the per frame cost can be seen.
+//
+//		myCANMcp2515 backend(CAN_CS_PIN);
+//		myCANDriverT<myCANMcp2515> can(&backend,CAN_INT_PIN);
+
+#pragma once
+
+#include "myCANBackend.h"
+#include <SPI.h>
+#include <mcp2515.h>
+
+#ifndef CAN_SPI_CLOCK
+	#define CAN_SPI_CLOCK			10000000	// the library's default
+#endif
+
+
+class myCANMcp2515 final : public myCANBackend
+{
+public:
+
+	myCANMcp2515(int cs_pin, SPIClass *spi=NULL, CAN_CLOCK clock=MCP_8MHZ);
+
+	bool begin(uint32_t bitrate) override;
+	bool setFilters(myCANFilter *filter) override;
+
+	uint8_t getEvents() override;
+	bool read(myCANFrame *frame) override;
+
+	int getTxSlots() override  { return CAN_MAX_TX_SLOTS; }
+	void load(int slot, const myCANFrame *frame) override;
+	void setRank(int slot, int rank) override;
+	bool abort(int slot) override;
+	bool aborted(int slot) override;
+
+	uint32_t getOverflows() override  { return m_overflows; }
+	void getErrorCounts(uint8_t *tec, uint8_t *rec, uint8_t *flags) override;
+	void getSpiCounts(uint32_t *transactions, uint32_t *bytes) override;
+
+private:
+
+	int m_cs_pin;
+	SPIClass *m_spi;
+	MCP2515 m_mcp;
+	CAN_CLOCK m_clock;
+
+	uint8_t m_irq;		// the RX flags not yet read
+	volatile uint32_t m_overflows;
+	uint32_t m_spi_transactions;
+	uint32_t m_spi_bytes;
+
+	void handleErrors();
+	void select();
+	void deselect(int bytes);
+	uint8_t quickRead(uint8_t instr);
+	void quickWrite(uint8_t instr);
+	uint8_t readReg(uint8_t reg);
+	void readRegs(uint8_t reg, uint8_t *values, int num);
+	void modifyReg(uint8_t reg, uint8_t mask, uint8_t value);
+};
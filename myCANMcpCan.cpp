@@ -0,0 +1,132 @@
+//-------------------------------------------
+// myCANMcpCan.cpp
+//-------------------------------------------
+
+#include "myCANMcpCan.h"
+
+#if __has_include(<mcp_can.h>)
+
+#include "myCANFilter.h"
+#include <myDebug.h>
+
+static const struct
+{
+	uint32_t bitrate;
+	uint8_t speed;
+} speeds[] =
+{
+	{ 1000000,	CAN_1000KBPS },
+	{ 500000,	CAN_500KBPS },
+	{ 250000,	CAN_250KBPS },
+	{ 200000,	CAN_200KBPS },
+	{ 125000,	CAN_125KBPS },
+	{ 100000,	CAN_100KBPS },
+	{ 50000,	CAN_50KBPS },
+	{ 20000,	CAN_20KBPS },
+	{ 10000,	CAN_10KBPS },
+	{ 5000,		CAN_5KBPS },
+};
+
+
+myCANMcpCan::myCANMcpCan(int cs_pin, SPIClass *spi/*=NULL*/, uint8_t clock/*=MCP_8MHz*/) :
+	m_can(cs_pin),
+	m_spi(spi),
+	m_clock(clock),
+	m_tx_done(0),
+	m_errors(0)
+{}
+
+
+bool myCANMcpCan::begin(uint32_t bitrate)
+{
+	int i = 0;
+	int num = sizeof(speeds) / sizeof(speeds[0]);
+	while (i < num && speeds[i].bitrate != bitrate)
+		i++;
+	if (i == num)
+	{
+		my_error("myCANMcpCan::begin() unsupported bitrate %d",bitrate);
+		return false;
+	}
+
+	if (m_spi)
+		m_can.setSPI(m_spi);
+	uint8_t err = m_can.begin(speeds[i].speed,m_clock);
+	if (err != CAN_OK)
+	{
+		my_error("myCANMcpCan::begin() err=%d",err);
+		return false;
+	}
+	return true;
+}
+
+
+bool myCANMcpCan::setFilters(myCANFilter *filter)
+	// the library goes to config mode, and back, for each one
+{
+	static myCANFilter open_filter;
+	if (!filter)
+		filter = &open_filter;
+
+	uint8_t err = CAN_OK;
+	for (int i=0; i<CAN_NUM_MASKS && err == CAN_OK; i++)
+		err = m_can.init_Mask(i,filter->getMaskExt(i),filter->getMask(i));
+	for (int i=0; i<CAN_NUM_FILTERS && err == CAN_OK; i++)
+		err = m_can.init_Filt(i,filter->getFilterExt(i),filter->getFilter(i));
+	if (err != CAN_OK)
+	{
+		my_error("myCANMcpCan::setFilters() err=%d",err);
+		return false;
+	}
+	return true;
+}
+
+
+uint8_t myCANMcpCan::getEvents()
+{
+	uint8_t events = 0;
+	if (m_can.checkError() == CAN_CTRLERROR)
+		m_errors++;
+	if (m_can.checkReceive() == CAN_MSGAVAIL)
+		events |= CAN_EVENT_RX;
+	if (m_tx_done)
+	{
+		events |= CAN_EVENT_TX0;
+		m_tx_done = 0;
+	}
+	return events;
+}
+
+
+bool myCANMcpCan::read(myCANFrame *frame)
+{
+	if (m_can.checkReceive() != CAN_MSGAVAIL)
+		return false;
+
+	unsigned long id;
+	uint8_t len;
+	if (m_can.readMsgBufID(&id,&len,frame->data) != CAN_OK)
+		return false;
+	frame->flags =
+		(m_can.isExtendedFrame() ? CAN_FRAME_EXT : 0) |
+		(m_can.isRemoteRequest() ? CAN_FRAME_RTR : 0);
+	frame->id = id & (frame->flags & CAN_FRAME_EXT ? 0x1FFFFFFF : 0x7FF);
+	frame->len = len > 8 ? 8 : len;
+	return true;
+}
+
+
+void myCANMcpCan::load(int slot, const myCANFrame *frame)
+{
+	uint8_t err = m_can.sendMsgBuf(
+		frame->id,
+		frame->flags & CAN_FRAME_EXT ? 1 : 0,
+		frame->flags & CAN_FRAME_RTR ? 1 : 0,
+		frame->len > 8 ? 8 : frame->len,
+		frame->data);
+	if (err != CAN_OK)
+		m_errors++;
+	m_tx_done = 1;
+}
+
+#endif	// __has_include(<mcp_can.h>)
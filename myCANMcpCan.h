@@ -0,0 +1,51 @@
+//-------------------------------------------
+// myCANMcpCan.h
+//-------------------------------------------
+// myCANBackend for an MCP2515 using the mcp_can library
+// (github/_ttlappalainen/CAN_BUS_Shield), HOW_BUS_CANBUS in
+// myCANBUS.h.
+//
+// The library hides the chip's registers, so there is a single
+// TX slot, and sendMsgBuf() waits for each frame to go out, which
+// holds up the driver's task for a frame time. The library's
+// mcp_can_dfs.h clashes with the autowp mcp2515.h, so only one of
+// the two backends can be used in a sketch, and this one compiles
+// to nothing if mcp_can.h is not installed.
+//
+//		myCANMcpCan backend(CAN_CS_PIN);
+//		myCANDriverT<myCANMcpCan> can(&backend,CAN_INT_PIN);
+
+#pragma once
+
+#if __has_include(<mcp_can.h>)
+
+#include "myCANBackend.h"
+#include <mcp_can.h>
+
+
+class myCANMcpCan final : public myCANBackend
+{
+public:
+
+	myCANMcpCan(int cs_pin, SPIClass *spi=NULL, uint8_t clock=MCP_8MHz);
+
+	bool begin(uint32_t bitrate) override;
+	bool setFilters(myCANFilter *filter) override;
+
+	uint8_t getEvents() override;
+	bool read(myCANFrame *frame) override;
+	void load(int slot, const myCANFrame *frame) override;
+
+	uint32_t getOverflows() override  { return m_errors; }
+		// the library only says there was an error
+
+private:
+
+	MCP_CAN m_can;
+	SPIClass *m_spi;
+	uint8_t m_clock;
+	bool m_tx_done;
+	uint32_t m_errors;
+};
+
+#endif	// __has_include(<mcp_can.h>)
@@ -0,0 +1,214 @@
+//-------------------------------------------
+// myCANTemp.cpp
+//-------------------------------------------
+
+#include "myCANTemp.h"
+#include <myDebug.h>
+
+
+myCANTempPublisher::myCANTempPublisher(uint32_t can_id) :
+	m_can_id(can_id),
+	m_ack_id(0),
+	m_with_ack(0),
+	m_ack_ms(CAN_TEMP_ACK_MS),
+	m_deadband(CAN_TEMP_DEADBAND),
+	m_max_interval(CAN_TEMP_MAX_INTERVAL_MS),
+	m_num(0),
+	m_frames(0),
+	m_resends(0)
+{
+	memset(m_sensors,0,sizeof(m_sensors));
+}
+
+
+void myCANTempPublisher::setAck(uint32_t ack_id, uint32_t timeout_ms/*=CAN_TEMP_ACK_MS*/)
+{
+	m_ack_id = ack_id;
+	m_ack_ms = timeout_ms;
+	m_with_ack = 1;
+}
+
+
+void myCANTempPublisher::update(int index, int16_t raw, uint8_t status)
+{
+	if (index < 0 || index >= CAN_TEMP_MAX_SENSORS)
+	{
+		my_error("myCANTempPublisher::update() index %d >= CAN_TEMP_MAX_SENSORS(%d)",index,CAN_TEMP_MAX_SENSORS);
+		return;
+	}
+	if (status == CAN_TEMP_PENDING)
+		return;
+
+	sensor_t *sensor = &m_sensors[index];
+	sensor->raw = raw;
+	sensor->status = status;
+	sensor->valid = 1;
+	if (index >= m_num)
+		m_num = index + 1;
+}
+
+
+void myCANTempPublisher::update(const int16_t *raw, const uint8_t *status, int num)
+{
+	for (int i=0; i<num; i++)
+		update(i,raw[i],status[i]);
+}
+
+
+uint32_t myCANTempPublisher::ackTimeout(const sensor_t *sensor)
+{
+	uint32_t timeout = m_ack_ms;
+	for (int i=0; i<sensor->retries && timeout < m_max_interval; i++)
+		timeout <<= 1;
+	return timeout < m_max_interval ? timeout : m_max_interval;
+}
+
+
+bool myCANTempPublisher::isDue(const sensor_t *sensor, uint32_t now)
+{
+	if (!sensor->valid)
+		return false;
+	if (!sensor->ever_sent || sensor->status != sensor->sent_status)
+		return true;
+	uint32_t elapsed = now - sensor->sent_time;
+	if (elapsed >= m_max_interval)
+		return true;
+	if (sensor->awaiting_ack && elapsed >= ackTimeout(sensor))
+		return true;
+	if (sensor->status != CAN_TEMP_OK)
+		return false;
+	int diff = sensor->raw - sensor->sent_raw;
+	return diff > m_deadband || diff < -m_deadband;
+}
+
+
+bool myCANTempPublisher::nextFrame(myCANFrame *frame, uint32_t now)
+{
+	int base = 0;
+	while (base < m_num && !isDue(&m_sensors[base],now))
+		base++;
+	if (base == m_num)
+		return false;
+
+	frame->time = 0;
+	frame->id = m_can_id;
+	frame->flags = 0;
+	memset(frame->data,0,8);
+	frame->data[0] = base;
+	frame->data[1] = m_with_ack ? CAN_TEMP_ACK : 0;
+	frame->len = 2;
+
+	for (int slot=0; slot<CAN_TEMP_SLOTS && base + slot < m_num; slot++)
+	{
+		const sensor_t *sensor = &m_sensors[base + slot];
+		if (!sensor->valid)
+			continue;
+		int16_t value = sensor->raw;
+		frame->data[1] |= CAN_TEMP_PRESENT << slot;
+		if (sensor->status != CAN_TEMP_OK)
+		{
+			frame->data[1] |= CAN_TEMP_STATUS << slot;
+			value = sensor->status;
+		}
+		frame->data[2 + slot * 2] = value;
+		frame->data[3 + slot * 2] = value >> 8;
+		frame->len = 4 + slot * 2;
+	}
+	return true;
+}
+
+
+void myCANTempPublisher::sent(const myCANFrame *frame, uint32_t now)
+{
+	int base = frame->data[0];
+	uint8_t mask = frame->data[1];
+	for (int slot=0; slot<CAN_TEMP_SLOTS && base + slot < m_num; slot++)
+	{
+		if (!(mask & (CAN_TEMP_PRESENT << slot)))
+			continue;
+		sensor_t *sensor = &m_sensors[base + slot];
+		if (sensor->awaiting_ack && now - sensor->sent_time >= ackTimeout(sensor))
+		{
+			m_resends++;
+			if (sensor->retries < 31)
+				sensor->retries++;
+		}
+		sensor->ever_sent = 1;
+		sensor->sent_raw = sensor->raw;
+		sensor->sent_status = sensor->status;
+		sensor->sent_time = now;
+		sensor->awaiting_ack = m_with_ack;
+	}
+	m_frames++;
+}
+
+
+bool myCANTempPublisher::ack(const myCANFrame *frame)
+{
+	if (!m_with_ack || frame->id != m_ack_id ||
+		(frame->flags & (CAN_FRAME_EXT | CAN_FRAME_RTR)))
+		return false;
+
+	myCANTempReading readings[CAN_TEMP_SLOTS];
+	int n = decode(frame,readings);
+	for (int i=0; i<n; i++)
+	{
+		if (readings[i].index >= m_num)
+			continue;
+		sensor_t *sensor = &m_sensors[readings[i].index];
+		if (readings[i].status == sensor->sent_status &&
+			(readings[i].status != CAN_TEMP_OK || readings[i].raw == sensor->sent_raw))
+		{
+			sensor->awaiting_ack = 0;
+			sensor->retries = 0;
+		}
+	}
+	return true;
+}
+
+
+//-----------------------------------
+// the receiver's side
+//-----------------------------------
+
+// static
+int myCANTempPublisher::decode(const myCANFrame *frame, myCANTempReading *readings)
+{
+	if (frame->len < 2 || (frame->flags & CAN_FRAME_RTR))
+		return 0;
+
+	int n = 0;
+	uint8_t mask = frame->data[1];
+	for (int slot=0; slot<CAN_TEMP_SLOTS; slot++)
+	{
+		if (!(mask & (CAN_TEMP_PRESENT << slot)) || frame->len < 4 + slot * 2)
+			continue;
+		int16_t value = frame->data[2 + slot * 2] | (frame->data[3 + slot * 2] << 8);
+		myCANTempReading *reading = &readings[n++];
+		reading->index = frame->data[0] + slot;
+		if (mask & (CAN_TEMP_STATUS << slot))
+		{
+			reading->status = value;
+			reading->raw = 0;
+		}
+		else
+		{
+			reading->status = CAN_TEMP_OK;
+			reading->raw = value;
+		}
+	}
+	return n;
+}
+
+
+// static
+bool myCANTempPublisher::makeAck(const myCANFrame *frame, uint32_t ack_id, myCANFrame *ack)
+{
+	if (frame->len < 2 || !(frame->data[1] & CAN_TEMP_ACK))
+		return false;
+	*ack = *frame;
+	ack->time = 0;
+	ack->id = ack_id;
+	ack->data[1] &= ~CAN_TEMP_ACK;
+	return true;
+}
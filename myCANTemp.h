@@ -0,0 +1,166 @@
+//-------------------------------------------
+// myCANTemp.h
+//-------------------------------------------
+// Publishes the readings of many temperature sensors on one
+// 11 bit id, MY_TEMPERATURE_CANID in myCANBUS.h, sending only what
+// has changed.
+//
+// Each frame carries up to three sensors, with consecutive indexes,
+// as raw 1/128 degree C values, as myTempSensor gives them:
+//
+//		data[0]			the index of the first slot
+//		data[1]			CAN_TEMP_PRESENT << slot for the slots sent,
+//						CAN_TEMP_STATUS << slot for those that carry a
+//						myTempSensor error code instead of a value, and
+//						CAN_TEMP_ACK if the sender wants an ack
+//		data[2..7]		int16_t per slot, little endian
+//
+// and is only as long as its last slot needs.
+//
+// A sensor is due when its value moves more than the deadband from
+// the value last sent, its status changes, or the max interval goes
+// by since it was last sent. publish() sends a frame for each due
+// sensor, taking along whatever its neighbours in the frame have,
+// which restarts their intervals for free, so that quiet sensors
+// are mostly refreshed in the frames of noisier ones.
+//
+//		myCANTempPublisher pub(MY_TEMPERATURE_CANID);
+//
+//		loop():
+//			int n = tsense.getSnapshots(raw,status,MAX_TSENSE_DEVICES);
+//			pub.update(raw,status,n);
+//			pub.publish(canBus());
+//
+// With setAck(), for WITH_ACK, frames ask for an ack, which the
+// receiver sends on the ack id, echoing the frame's data, and a
+// sensor whose value is not acked within the timeout is sent again.
+// Each resend without an ack doubles the timeout, up to the max
+// interval, so that a missing receiver costs no more than a quiet
+// bus, and the next ack starts it over. An ack for a value that has
+// since been replaced is ignored. The receiver's side is decode()
+// and makeAck().
+//
+// Only one node may send on a given id, as two frames with the same
+// id and different data would both win arbitration and collide.
+
+#pragma once
+
+#include <Arduino.h>
+#include "myCANFrame.h"
+
+#ifndef CAN_TEMP_MAX_SENSORS
+	#define CAN_TEMP_MAX_SENSORS		16		// MAX_TSENSE_DEVICES
+#endif
+#ifndef CAN_TEMP_DEADBAND
+	#define CAN_TEMP_DEADBAND			16		// 1/8 degree C
+#endif
+#ifndef CAN_TEMP_MAX_INTERVAL_MS
+	#define CAN_TEMP_MAX_INTERVAL_MS	10000
+#endif
+#ifndef CAN_TEMP_ACK_MS
+	#define CAN_TEMP_ACK_MS				250
+#endif
+
+#define CAN_TEMP_SLOTS				3
+
+#define CAN_TEMP_PRESENT			0x01	// << slot
+#define CAN_TEMP_STATUS				0x10	// << slot
+#define CAN_TEMP_ACK				0x80
+
+#define CAN_TEMP_OK					0		// TSENSE_OK
+#define CAN_TEMP_PENDING			7		// TSENSE_ERROR_PENDING, not sent
+
+
+typedef struct
+{
+	uint8_t index;
+	uint8_t status;			// CAN_TEMP_OK or a myTempSensor error code
+	int16_t raw;			// 1/128 degrees C if status is OK
+} myCANTempReading;
+
+
+class myCANTempPublisher
+{
+public:
+
+	myCANTempPublisher(uint32_t can_id);
+
+	void setDeadband(int16_t raw)  { m_deadband = raw; }
+		// 1/128 degrees C, CAN_TEMP_DEADBAND by default
+	void setMaxInterval(uint32_t ms)  { m_max_interval = ms; }
+		// CAN_TEMP_MAX_INTERVAL_MS by default
+	void setAck(uint32_t ack_id, uint32_t timeout_ms=CAN_TEMP_ACK_MS);
+		// ask for acks on ack_id, for WITH_ACK
+
+	void update(int index, int16_t raw, uint8_t status);
+	void update(const int16_t *raw, const uint8_t *status, int num);
+		// from myTempSensor::getSnapshots(), or readAll();
+		// PENDING readings are ignored
+
+	bool nextFrame(myCANFrame *frame, uint32_t now);
+		// builds the frame for the lowest due sensor, and returns
+		// false if nothing is due
+	void sent(const myCANFrame *frame, uint32_t now);
+		// marks what was in a frame from nextFrame() as sent
+
+	template <class DRIVER>
+	int publish(DRIVER *can)
+		// sends what is due, until the driver's queue is full,
+		// and returns the number of frames sent
+	{
+		uint32_t now = millis();
+		myCANFrame frame;
+		int n = 0;
+		while (nextFrame(&frame,now) && can->send(&frame))
+		{
+			sent(&frame,now);
+			n++;
+		}
+		return n;
+	}
+
+	bool ack(const myCANFrame *frame);
+		// returns true if the frame is an ack for this publisher
+
+	uint32_t getFrames()	{ return m_frames; }
+	uint32_t getResends()	{ return m_resends; }
+
+	// the receiver's side
+
+	static int decode(const myCANFrame *frame, myCANTempReading *readings);
+		// returns the number of readings, up to CAN_TEMP_SLOTS
+	static bool makeAck(const myCANFrame *frame, uint32_t ack_id, myCANFrame *ack);
+		// returns false if the frame did not ask for one
+
+private:
+
+	typedef struct
+	{
+		int16_t raw;
+		uint8_t status;
+		bool valid;			// has a reading
+		bool ever_sent;
+		bool awaiting_ack;
+		uint8_t retries;		// resends since the last ack
+		int16_t sent_raw;
+		uint8_t sent_status;
+		uint32_t sent_time;
+	} sensor_t;
+
+	uint32_t m_can_id;
+	uint32_t m_ack_id;
+	bool m_with_ack;
+	uint32_t m_ack_ms;
+	int16_t m_deadband;
+	uint32_t m_max_interval;
+
+	int m_num;				// highest index updated + 1
+	sensor_t m_sensors[CAN_TEMP_MAX_SENSORS];
+
+	uint32_t m_frames;
+	uint32_t m_resends;
+
+	uint32_t ackTimeout(const sensor_t *sensor);
+	bool isDue(const sensor_t *sensor, uint32_t now);
+
+};
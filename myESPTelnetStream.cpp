@@ -35,68 +35,117 @@ static volatile bool in_flush;
 static volatile size_t telnet_bytes;
 static uint8_t telnet_buffer[MAX_TELNET_BYTES];
 static uint32_t last_telnet_time;
+static int line_max;			// from beginLine() to endLine()
 
 uint32_t myESPTelnetStream::m_num_missed;		// writes while disconnected
 uint32_t myESPTelnetStream::m_num_error;		// flush errors
 uint32_t myESPTelnetStream::m_num_warning;		// flush warnings
 uint32_t myESPTelnetStream::m_num_overflow;		// overflows in write
-uint32_t myESPTelnetStream::m_num_wait;			// wait loops for flushOutput from write
+uint32_t myESPTelnetStream::m_num_wait;			// waits in write for a line or flushOutput
 
 
 
 size_t myESPTelnetStream::write(uint8_t byte)	// override;
+	// Claims in_flush, as beginLine() does, so that a byte written
+	// from another task waits for a line being formatted in place,
+	// or a flush, to finish, rather than landing in the middle of it.
 {
 	if (!client || !isConnected())
 	{
 		m_num_missed++;		// writes while disconnected
-		telnet_bytes = 0;
 		return 0;
 	}
-	
+
+	if (__sync_lock_test_and_set(&in_flush,1))
+	{
+		m_num_wait++;		// waits in write for a line or flushOutput
+		while (__sync_lock_test_and_set(&in_flush,1))
+			delay(1);
+	}
+
 	if (telnet_bytes >= MAX_TELNET_BYTES)
 	{
 		m_num_overflow++;		// overflows in write
 		Serial.println("myESPTelnetStream flushing buffer");
-		flushOutput();
+		doFlush(true);
+	}
 
-		int counter = 0;
-		uint32_t start = millis();
-		while (in_flush)
-		{
-			uint32_t now = millis();
-			if (now - start > 1000)
-			{
-				m_num_wait++;			// wait loops for flushOutput from write
-				Serial.print("waiting for flush to complete ");
-				Serial.println(counter++);
-				start = now;
-			}
-		}
+	size_t rslt = 0;
+	if (telnet_bytes < MAX_TELNET_BYTES)
+	{
+		telnet_buffer[telnet_bytes++] = byte;
+		rslt = 1;
 	}
+	__sync_lock_release(&in_flush);
+	return rslt;
+}
+
 
-	telnet_buffer[telnet_bytes++] = byte;
-	return 1;
+
+char *myESPTelnetStream::beginLine(int max_len)
+	// Holds in_flush until endLine(), so that the task's flushOutput()
+	// cannot reset or move the buffer under the line being formatted.
+{
+	if (!client || !isConnected())
+	{
+		m_num_missed++;		// writes while disconnected
+		return NULL;
+	}
+
+	while (__sync_lock_test_and_set(&in_flush,1))
+		delay(1);
+
+	size_t need = max_len + 3;	// CR, LF, and zero
+	if (telnet_bytes + need > MAX_TELNET_BYTES)
+		doFlush(true);
+	if (telnet_bytes + need > MAX_TELNET_BYTES)
+	{
+		m_num_overflow++;		// overflows in write
+		__sync_lock_release(&in_flush);
+		return NULL;
+	}
+	line_max = max_len;
+	return (char *) &telnet_buffer[telnet_bytes];
+}
+
+
+void myESPTelnetStream::endLine(int len, bool crlf/*=true*/)
+{
+	if (len > line_max)
+		len = line_max;
+	if (crlf)
+	{
+		telnet_buffer[telnet_bytes + len++] = '\r';
+		telnet_buffer[telnet_bytes + len++] = '\n';
+	}
+	telnet_bytes += len;
+	__sync_lock_release(&in_flush);
 }
 
 
 
 void myESPTelnetStream::flushOutput()
 {
-	if (in_flush)
+	if (__sync_lock_test_and_set(&in_flush,1))
 		return;
-	in_flush = 1;
+	doFlush(false);
+	__sync_lock_release(&in_flush);
+}
 
+
+void myESPTelnetStream::doFlush(bool force)
+	// called with in_flush held
+{
 	// Serial.println("flushOutput");
 		
 	if (!client || !isConnected())
 	{
 		telnet_bytes = 0;
-		in_flush = 0;
 		return;
 	}
 
 	uint32_t now = millis();
-	if (now - last_telnet_time >= TELNET_MS)
+	if (force || now - last_telnet_time >= TELNET_MS)
 	{
 		last_telnet_time = now;
 		
@@ -152,7 +201,6 @@ void myESPTelnetStream::flushOutput()
 			}
 		}
 	}
-	in_flush = 0;
 }
 
 
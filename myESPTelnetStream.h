@@ -24,15 +24,27 @@ public:
 
 	void flushOutput();
 
+	char *beginLine(int max_len);
+	void endLine(int len, bool crlf=true);
+		// for formatting directly into the output buffer, i.e. with
+		// myFastFormat. beginLine() returns room for max_len characters
+		// plus a terminating zero, or NULL if disconnected or full.
+		// endLine() commits len characters, at most max_len, and
+		// optionally a CR/LF. flushOutput() does nothing in between,
+		// and writes from other tasks wait, so endLine() must follow
+		// every beginLine() that did not return NULL soon, and the
+		// task that called beginLine() must not write() until then.
+
 	static uint32_t m_num_missed;		// writes while disconnected
 	static uint32_t m_num_error;		// flush errors
 	static uint32_t m_num_warning;		// flush warnings
 	static uint32_t m_num_overflow;		// overflows in write
-	static uint32_t m_num_wait;			// wait loops for flushOutput from write
+	static uint32_t m_num_wait;			// waits in write for a line or flushOutput
 
 private:
 	
 	size_t write(uint8_t) override;
+	void doFlush(bool force);
 	
 };
 
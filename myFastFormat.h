@@ -0,0 +1,173 @@
+//-----------------------------------------------------------
+// myFastFormat.h
+//-----------------------------------------------------------
+// A small fixed-width formatter for the integer, hex and
+// fixed-point fields that dominate my logging, as a cheaper
+// alternative to vsnprintf().
+//
+// The format of each field is given by template parameters,
+// so it is resolved at compile time, and the characters are
+// written directly into the caller's buffer, typically a
+// myOledMonitor row or the myESPTelnetStream output buffer,
+// with no heap and only a few bytes of stack.
+//
+//		char *row = myOledMonitor::beginLine();
+//		myFastFormat(row,myOledMonitor::getCols())
+//			.str("T1=").fixed<6,2>(degrees)
+//			.str(" id=").hex<4>(can_id)
+//			.end();
+//		myOledMonitor::endLine();
+//
+// Fields that do not fit their width are filled with '*'.
+// Nothing is ever written past the width given to the ctor,
+// plus the terminating zero written by end().
+
+#pragma once
+
+#include <stdint.h>
+
+
+template <int N> struct myPow10 { static const int32_t value = 10 * myPow10<N-1>::value; };
+template <> struct myPow10<0> { static const int32_t value = 1; };
+
+
+class myFastFormat
+{
+public:
+
+	myFastFormat(char *buf, int width) :
+		m_buf(buf),
+		m_len(0),
+		m_width(width) {}
+
+	int end(bool pad=true)
+		// pads with spaces to the width if pad, zero terminates,
+		// and returns the number of characters written
+	{
+		if (pad)
+			while (m_len < m_width)
+				m_buf[m_len++] = ' ';
+		m_buf[m_len] = 0;
+		return m_len;
+	}
+
+	int length() { return m_len; }
+
+	myFastFormat &chr(char c)
+	{
+		if (m_len < m_width)
+			m_buf[m_len++] = c;
+		return *this;
+	}
+
+	myFastFormat &str(const char *s)
+	{
+		while (*s && m_len < m_width)
+			m_buf[m_len++] = *s++;
+		return *this;
+	}
+
+	template <int W>
+	myFastFormat &left(const char *s)
+		// string left justified in W characters
+	{
+		int i = 0;
+		while (i < W && s[i])
+			chr(s[i++]);
+		while (i++ < W)
+			chr(' ');
+		return *this;
+	}
+
+	template <int W>
+	myFastFormat &dec(int32_t value)
+		// signed decimal right justified in W characters
+	{
+		char tmp[12];
+		int n = 0;
+		bool neg = value < 0;
+		uint32_t u = neg ? 0 - (uint32_t) value : value;
+		do { tmp[n++] = '0' + u % 10; u /= 10; } while (u);
+		if (neg)
+			tmp[n++] = '-';
+		return right<W>(tmp,n);
+	}
+
+	template <int W>
+	myFastFormat &hex(uint32_t value)
+		// upper case hex, zero filled to W digits
+	{
+		for (int i=W-1; i>=0; i--)
+		{
+			uint8_t nibble = i < 8 ? (value >> (i * 4)) & 0x0f : 0;
+			chr(nibble < 10 ? '0' + nibble : 'A' + nibble - 10);
+		}
+		return *this;
+	}
+
+	template <int W, int D>
+	myFastFormat &fixed(float value)
+		// float with D decimals right justified in W characters
+	{
+		float scaled = value * myPow10<D>::value;
+		int32_t v = scaled < 0 ? (int32_t) (scaled - 0.5f) : (int32_t) (scaled + 0.5f);
+		return scaledDec<W,D>(v);
+	}
+
+	template <int W, int D, int SHIFT>
+	myFastFormat &fixedRaw(int32_t raw)
+		// binary fixed point raw / 2^SHIFT with D decimals right justified
+		// in W characters, using integer math only; i.e. fixedRaw<7,2,7>()
+		// for the 1/128 degree raw values from myTempSensor
+	{
+		bool neg = raw < 0;
+		uint32_t u = neg ? 0 - (uint32_t) raw : raw;
+		u = (u * (uint32_t) myPow10<D>::value + (1 << (SHIFT - 1))) >> SHIFT;
+		return scaledDec<W,D>(neg ? -(int32_t) u : u);
+	}
+
+
+private:
+
+	char *m_buf;
+	int m_len;
+	int m_width;
+
+	template <int W>
+	myFastFormat &right(const char *reversed, int n)
+	{
+		if (n > W)
+		{
+			for (int i=0; i<W; i++)
+				chr('*');
+			return *this;
+		}
+		for (int i=n; i<W; i++)
+			chr(' ');
+		while (n)
+			chr(reversed[--n]);
+		return *this;
+	}
+
+	template <int W, int D>
+	myFastFormat &scaledDec(int32_t value)
+		// value * 10^D with a decimal point inserted
+	{
+		char tmp[14];
+		int n = 0;
+		bool neg = value < 0;
+		uint32_t u = neg ? 0 - (uint32_t) value : value;
+		for (int i=0; i<D; i++)
+		{
+			tmp[n++] = '0' + u % 10;
+			u /= 10;
+		}
+		if (D)
+			tmp[n++] = '.';
+		do { tmp[n++] = '0' + u % 10; u /= 10; } while (u);
+		if (neg)
+			tmp[n++] = '-';
+		return right<W>(tmp,n);
+	}
+
+};
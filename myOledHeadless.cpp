@@ -0,0 +1,179 @@
+//--------------------------------------------------------
+// myOledHeadless.cpp
+//--------------------------------------------------------
+
+#include "myOledHeadless.h"
+#include "myOledMonitor.h"
+
+#define ST7789_ADDR_WINDOW_BYTES	11		// CASET(1+4) RASET(1+4) RAMWR(1)
+#define SSD1306_HEADER_BYTES		8		// 0x00 PAGEADDR(3) COLUMNADDR(2), then 0x00 + column end
+#define SSD1306_HEADER_TRANSACTIONS	2
+#define SSD1306_I2C_CHUNK			32		// WIRE_MAX, including the 0x40 data prefix
+
+
+myOledHeadless::myOledHeadless(int16_t w, int16_t h, uint16_t driver) :
+	Adafruit_GFX(w,h),
+	m_spi(driver & DRIVER_MASK_ST7789),
+	m_in_write(0)
+{
+	m_buffer = new uint16_t[w * h];
+	memset(m_buffer,0,w * h * sizeof(uint16_t));
+	resetCounters();
+}
+
+
+myOledHeadless::~myOledHeadless()
+{
+	delete[] m_buffer;
+}
+
+
+void myOledHeadless::resetCounters()
+{
+	m_pixels = 0;
+	m_transactions = 0;
+	m_bus_bytes = 0;
+}
+
+
+uint16_t myOledHeadless::getPixel(int16_t x, int16_t y)
+{
+	int16_t w = 1;
+	int16_t h = 1;
+	if (!clip(x,y,w,h))
+		return 0;
+	int16_t t;
+	switch (rotation)
+	{
+		case 1: t = x; x = WIDTH - 1 - y; y = t; break;
+		case 2: x = WIDTH - 1 - x; y = HEIGHT - 1 - y; break;
+		case 3: t = x; x = y; y = HEIGHT - 1 - t; break;
+	}
+	return m_buffer[y * WIDTH + x];
+}
+
+
+void myOledHeadless::display()
+{
+	if (m_spi)
+		return;
+	uint32_t data_bytes = WIDTH * ((HEIGHT + 7) / 8);
+	uint32_t chunks = (data_bytes + SSD1306_I2C_CHUNK - 2) / (SSD1306_I2C_CHUNK - 1);
+	m_transactions += SSD1306_HEADER_TRANSACTIONS + chunks;
+	m_bus_bytes += SSD1306_HEADER_BYTES + data_bytes + chunks;
+}
+
+
+//--------------------------------------
+// private
+//--------------------------------------
+
+bool myOledHeadless::clip(int16_t &x, int16_t &y, int16_t &w, int16_t &h)
+	// clip to the logical (rotated) screen,
+	// returns false if nothing is left
+{
+	if (x < 0) { w += x; x = 0; }
+	if (y < 0) { h += y; y = 0; }
+	if (x + w > _width) w = _width - x;
+	if (y + h > _height) h = _height - y;
+	return w > 0 && h > 0;
+}
+
+
+void myOledHeadless::setPixels(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+	// the workhorse: clips, counts and writes a rectangle
+	// in logical coordinates into the native framebuffer
+{
+	if (!clip(x,y,w,h))
+		return;
+
+	uint32_t count = (uint32_t) w * h;
+	m_pixels += count;
+	if (m_spi)
+	{
+		if (!m_in_write)
+			m_transactions++;
+		m_bus_bytes += ST7789_ADDR_WINDOW_BYTES + count * 2;
+	}
+
+	for (int16_t j=0; j<h; j++)
+	{
+		for (int16_t i=0; i<w; i++)
+		{
+			int16_t px = x + i;
+			int16_t py = y + j;
+			int16_t t;
+			switch (rotation)
+			{
+				case 1: t = px; px = WIDTH - 1 - py; py = t; break;
+				case 2: px = WIDTH - 1 - px; py = HEIGHT - 1 - py; break;
+				case 3: t = px; px = py; py = HEIGHT - 1 - t; break;
+			}
+			m_buffer[py * WIDTH + px] = color;
+		}
+	}
+}
+
+
+//--------------------------------------
+// Adafruit_GFX
+//--------------------------------------
+// Overridden in the same pattern as Adafruit_SPITFT so that
+// a drawChar() counts as one transaction, as it would on the wire.
+
+void myOledHeadless::startWrite()
+{
+	if (!m_in_write++ && m_spi)
+		m_transactions++;
+}
+
+void myOledHeadless::endWrite()
+{
+	if (m_in_write)
+		m_in_write--;
+}
+
+void myOledHeadless::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+	setPixels(x,y,1,1,color);
+}
+
+void myOledHeadless::writePixel(int16_t x, int16_t y, uint16_t color)
+{
+	setPixels(x,y,1,1,color);
+}
+
+void myOledHeadless::writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	setPixels(x,y,w,h,color);
+}
+
+void myOledHeadless::writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+	setPixels(x,y,1,h,color);
+}
+
+void myOledHeadless::writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+	setPixels(x,y,w,1,color);
+}
+
+void myOledHeadless::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+	setPixels(x,y,w,h,color);
+}
+
+void myOledHeadless::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+	setPixels(x,y,1,h,color);
+}
+
+void myOledHeadless::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+	setPixels(x,y,w,1,color);
+}
+
+void myOledHeadless::fillScreen(uint16_t color)
+{
+	setPixels(0,0,_width,_height,color);
+}
@@ -0,0 +1,70 @@
+//--------------------------------------------------------
+// myOledHeadless.h
+//--------------------------------------------------------
+// An in-memory Adafruit_GFX drawing surface that stands in
+// for an SSD1306 or ST7789 so that myOledMonitor can be run
+// and benchmarked without hardware, including on a Linux host
+// (see extras/oledBench).
+//
+// It keeps a framebuffer and counts the pixels written, and the
+// bus transactions and bytes that the real driver would have
+// sent over SPI (ST7789) or I2C (SSD1306).
+//
+// ST7789 model: every startWrite()/endWrite() pair is one SPI
+//		transaction, every pixel or rectangle costs an address
+//		window (CASET, RASET, RAMWR = 11 bytes) plus 2 bytes per pixel.
+// SSD1306 model: drawing only touches the RAM buffer, and display()
+//		sends an 8 byte command header, in two I2C transactions,
+//		as Adafruit_SSD1306 does, plus the whole buffer in I2C
+//		transactions of at most 32 bytes.
+
+#pragma once
+
+#include <Adafruit_GFX.h>
+
+
+class myOledHeadless final : public Adafruit_GFX
+{
+public:
+
+	myOledHeadless(int16_t w, int16_t h, uint16_t driver);
+		// w and h in native rotation(0), driver is DRIVER_SSD1306_xxx
+		// or DRIVER_ST7789_xxx and determines the bus model
+	~myOledHeadless();
+
+	void display();
+		// SSD1306 only; counts the transfer of the buffer
+
+	uint16_t getPixel(int16_t x, int16_t y);
+		// in logical (rotated) coordinates
+
+	void resetCounters();
+
+	uint32_t m_pixels;			// pixels written
+	uint32_t m_transactions;	// bus transactions (CS assertions or I2C transfers)
+	uint32_t m_bus_bytes;		// bytes that would have crossed the bus
+
+	// Adafruit_GFX
+
+	void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+	void startWrite() override;
+	void endWrite() override;
+	void writePixel(int16_t x, int16_t y, uint16_t color) override;
+	void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+	void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+	void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+	void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+	void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+	void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+	void fillScreen(uint16_t color) override;
+
+private:
+
+	bool m_spi;
+	int m_in_write;
+	uint16_t *m_buffer;
+
+	bool clip(int16_t &x, int16_t &y, int16_t &w, int16_t &h);
+	void setPixels(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+};
@@ -6,12 +6,15 @@
 // Normalizes rotations to a horizontal orientation
 
 #include "myOledMonitor.h"
+#include "myOledHeadless.h"
 // #include <myDebug.h>
 //	   client must include myDebug.h because display() define
 //	   conflicts with SSD1306 library, so we call display_fxn directly herein
 #include <Adafruit_GFX.h>
-#include <Adafruit_ST7789.h>
-#include <Adafruit_SSD1306.h>
+#ifdef ESP32
+	#include <Adafruit_ST7789.h>
+	#include <Adafruit_SSD1306.h>
+#endif
 
 
 #define DEBUG_SCREEN  0
@@ -21,6 +24,8 @@
 #define GFX_CHAR_WIDTH     	6       // at size 1, 5x8 + 1 space = 21.3 characters
 #define GFX_CHAR_HEIGHT    	8
 
+#define MAX_OLED_COLS		(320 / GFX_CHAR_WIDTH)	// the widest screen at size 1
+
 #define COLOR_BLACK			0
 #define ST7789_WHITE		0xffff
 #define ST1306_WHITE		1
@@ -41,9 +46,12 @@
 #define ST7789_DC    	2		// hardwired on ideaspark module
 #define ST7789_RST   	4		// hardwired on ideaspark module
 
-Adafruit_ST7789 *st7789;
-Adafruit_SSD1306 *ssd1306;
+#ifdef ESP32
+	Adafruit_ST7789 *st7789;
+	Adafruit_SSD1306 *ssd1306;
+#endif
 Adafruit_GFX *oled;
+static myOledHeadless *headless;
 
 static uint16_t COLOR_WHITE;
 
@@ -51,6 +59,12 @@ static uint16_t g_driver;
 static int g_font_size;
 static int g_with_task;
 static int g_with_display;
+static int g_task_core = OLED_TASK_CORE;
+static int g_task_priority = OLED_TASK_PRIORITY;
+static int g_max_fps = OLED_MAX_FPS;
+#ifdef ESP32
+	static TaskHandle_t update_task;
+#endif
 
 static int screen_width;
 static int screen_height;
@@ -58,18 +72,64 @@ static int char_width;
 static int char_height;
 static int oled_cols;
 static int oled_rows;
+static int pinned_rows;
+static int scroll_rows;		// oled_rows - pinned_rows
 static char *screen_buf;
 
 static volatile int head;
 static volatile int tail;
 static volatile int print_counter;
+static volatile int field_counter;
 static volatile bool in_print;
 
+// fields in the pinned rows
+
+typedef struct
+{
+	int row;
+	int col;					// of the value, after any shown name
+	int width;					// of the value
+	const char *name;
+	bool show_name;
+	bool name_dirty;
+	int dirty_lo;				// range of changed characters in value
+	int dirty_hi;				// empty if dirty_lo > dirty_hi
+	char *value;
+} oledField_t;
+
+static int num_fields;
+static oledField_t fields[MAX_OLED_FIELDS];
+
+// scrollback history, a byte ring of lines encoded as
+// [len] [len encoded bytes] [len], so it can be walked in
+// either direction. Encoded bytes >= SB_RUN are runs of spaces.
+
+#define SB_RUN			0x80
+
+static int sb_size;				// as last set by setScrollback()
+static bool sb_psram;
+static uint8_t *sb_buf;
+static int sb_alloc;			// the size of sb_buf
+static int sb_head;				// where the next line goes
+static int sb_tail;				// start of the oldest line
+static int sb_used;				// bytes in use
+static int sb_lines;			// lines in the history
+static volatile int sb_view;	// lines scrolled back, 0 = live
+static volatile int view_counter;
+static char *sb_row;			// decode buffer for rendering
+
 
 // forward, extern, and convenience declarations
 
 static void update();
-static void updateTask(void *param);
+static void updateScrollback();
+static void addHistory(const char *line);
+static void updateFields();
+static void showDisplay();
+static void wakeUpdate();
+#ifdef ESP32
+	static void updateTask(void *param);
+#endif
 extern void display_fxn(const char *alt_color, int level, const char *format, ...);
 
 #define buf_row(r)		(&screen_buf[(r) * (oled_cols+1)])
@@ -89,7 +149,7 @@ myOledMonitor::myOledMonitor(uint16_t driver, int font_size/*=2*/, bool with_tas
 
 	// native screen sizes in rotation(0)
 	
-	if (g_driver == DRIVER_ST7789_320x170)
+	if (g_driver & DRIVER_MASK_ST7789)
 	{
 		screen_width = 170;
 		screen_height = 320;
@@ -99,7 +159,7 @@ myOledMonitor::myOledMonitor(uint16_t driver, int font_size/*=2*/, bool with_tas
 	{
 		screen_width = 128;
 		COLOR_WHITE = ST1306_WHITE;
-		if (g_driver == DRIVER_SSD1306_128x64)
+		if ((g_driver & ~DRIVER_HEADLESS) == DRIVER_SSD1306_128x64)
 			screen_height = 64;
 		else
 			screen_height = 32;
@@ -107,6 +167,15 @@ myOledMonitor::myOledMonitor(uint16_t driver, int font_size/*=2*/, bool with_tas
 }
 
 
+// static
+void myOledMonitor::setTaskParams(int core, int priority, int max_fps/*=OLED_MAX_FPS*/)
+{
+	g_task_core = core;
+	g_task_priority = priority;
+	g_max_fps = max_fps;
+}
+
+
 // static
 void myOledMonitor::init(int rotation/*=0*/, bool with_display/*=false*/)
 {
@@ -125,7 +194,27 @@ void myOledMonitor::init(int rotation/*=0*/, bool with_display/*=false*/)
 	// initialize with native constants
 	// then use logical constants
 
-	if (g_driver == DRIVER_ST7789_320x170)
+	delete headless;	// benchmarks re-init with different drivers
+	headless = NULL;
+
+#ifndef ESP32
+	if (!(g_driver & DRIVER_HEADLESS))
+	{
+		// the buffers below, and oled, must always be set up,
+		// so a host build models the driver headless instead
+
+		display_fxn(0,0,"myOledMonitor: using DRIVER_HEADLESS in a host build",0);
+		g_driver |= DRIVER_HEADLESS;
+	}
+#endif
+
+	if (g_driver & DRIVER_HEADLESS)
+	{
+		headless = new myOledHeadless(screen_width, screen_height, g_driver);
+		oled = headless;
+	}
+#ifdef ESP32
+	else if (g_driver == DRIVER_ST7789_320x170)
 	{
 		display_fxn(0,0,"initing 7789",0);
 		st7789 = new Adafruit_ST7789(ESP32_CS, ST7789_DC, ST7789_RST);
@@ -141,6 +230,7 @@ void myOledMonitor::init(int rotation/*=0*/, bool with_display/*=false*/)
 		ssd1306->clearDisplay();
 		oled = ssd1306;
 	}
+#endif
 
 	// switch logical height and width by rotation
 	// and set logical number of rows and columns
@@ -154,14 +244,57 @@ void myOledMonitor::init(int rotation/*=0*/, bool with_display/*=false*/)
 
 	oled_cols = screen_width/char_width;
 	oled_rows = screen_height/char_height;
+	if (pinned_rows > oled_rows - 1)
+		pinned_rows = oled_rows > 0 ? oled_rows - 1 : 0;
+	scroll_rows = oled_rows - pinned_rows;
 
 	#if DEBUG_SCREEN
-		display_fxn(0,0,"oled_rows(%d) oled_cols(%d)",oled_rows,oled_cols);
+		display_fxn(0,0,"oled_rows(%d) oled_cols(%d) pinned_rows(%d)",oled_rows,oled_cols,pinned_rows);
 	#endif
 	// initialize the screen buffer
 
-	screen_buf = new char[(oled_rows+1) * (oled_cols+1)];
-	memset(screen_buf,0,(oled_rows+1) * (oled_cols+1));
+	delete[] screen_buf;
+	screen_buf = new char[(scroll_rows+1) * (oled_cols+1)];
+	memset(screen_buf,0,(scroll_rows+1) * (oled_cols+1));
+	head = 0;
+	tail = 0;
+
+	for (int i=0; i<num_fields; i++)
+		delete[] fields[i].value;
+	num_fields = 0;
+
+	// the scrollback's size does not depend on rotation, so it
+	// is only reallocated if setScrollback() changed it
+
+	if (sb_buf && sb_alloc != sb_size)
+	{
+		free(sb_buf);
+		sb_buf = NULL;
+		sb_alloc = 0;
+	}
+	if (sb_size && !sb_buf)
+	{
+		#ifdef ESP32
+			if (sb_psram && psramFound())
+				sb_buf = (uint8_t *) ps_malloc(sb_size);
+		#endif
+		if (!sb_buf)
+			sb_buf = (uint8_t *) malloc(sb_size);
+		if (!sb_buf)
+		{
+			display_fxn(0,0,"myOledMonitor could not allocate %d byte scrollback",sb_size);
+			sb_size = 0;
+		}
+		else
+			sb_alloc = sb_size;
+	}
+	sb_head = 0;
+	sb_tail = 0;
+	sb_used = 0;
+	sb_lines = 0;
+	sb_view = 0;
+	delete[] sb_row;
+	sb_row = new char[oled_cols + 1];
 
 	// set the rotation
 
@@ -183,33 +316,55 @@ void myOledMonitor::init(int rotation/*=0*/, bool with_display/*=false*/)
 	oled->setTextSize(g_font_size);
 	oled->setTextColor(COLOR_WHITE,COLOR_BLACK);
 	oled->setTextWrap(false);
-	
-	if (g_driver & DRIVER_MASK_SSD1306)
-		ssd1306->display();
+	showDisplay();
 
+#ifdef ESP32
 	if (g_with_task)
 	{
-        #define ESP32_CORE_ARDUINO 	1
-        #define ESP32_CORE_OTHER  	0
-
-        // must run on ESP32_CORE_ARDUINO
+        // defaults to ESP32_CORE_ARDUINO(1)
 
         #if DEBUG_SCREEN
-			display_fxn(0,0,"creating myOledMonitor::monUpdateTask pinned to core %d",ESP32_CORE_ARDUINO);
+			display_fxn(0,0,"creating myOledMonitor::monUpdateTask pinned to core %d priority(%d) max_fps(%d)",
+				g_task_core,g_task_priority,g_max_fps);
 	    #endif
 
 		xTaskCreatePinnedToCore(
 			updateTask,
 			"monUpdateTask",
-			4096,	// stack
-			NULL,	// param
-			5,  	// priority
-			NULL,   // handle
-			ESP32_CORE_ARDUINO);
+			4096,				// stack
+			NULL,				// param
+			g_task_priority,
+			&update_task,		// handle
+			g_task_core);
 	}
+#endif
 }
 
 
+// static
+void myOledMonitor::setPinnedRows(int num_rows)
+{
+	pinned_rows = num_rows > 0 ? num_rows : 0;
+}
+
+
+// static
+void myOledMonitor::setScrollback(int num_bytes, bool use_psram/*=true*/)
+{
+	sb_size = num_bytes;
+	sb_psram = use_psram;
+}
+
+
+// static
+myOledHeadless *myOledMonitor::getHeadless()
+{
+	return headless;
+}
+
+
+
+#ifdef ESP32
 
 void updateTask(void *param)
 {
@@ -218,30 +373,104 @@ void updateTask(void *param)
 		display_fxn(0,0,"starting myOledMonitor::monUpdateTask() on core(%d)",xPortGetCoreID());
 	#endif
 	
+	// The task blocks until println() notifies it, so an idle
+	// monitor costs nothing. After a notification we wait out the
+	// rest of the frame interval, and any lines printed during that
+	// wait are coalesced into the same frame.
+
+	TickType_t last_frame = xTaskGetTickCount();
     while (1)
     {
-        vTaskDelay(1);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		if (g_max_fps > 0)
+		{
+			TickType_t frame_ticks = pdMS_TO_TICKS(1000 / g_max_fps);
+			TickType_t elapsed = xTaskGetTickCount() - last_frame;
+			if (elapsed < frame_ticks)
+				vTaskDelay(frame_ticks - elapsed);
+			ulTaskNotifyTake(pdTRUE, 0);
+				// clear notifications that arrived while waiting
+		}
+
+		last_frame = xTaskGetTickCount();
         update();
     }
 }
 
+#endif	// ESP32
+
 
 //------------------------------------------------------
 // update and println
 //------------------------------------------------------
 
+static void showDisplay()
+	// SSD1306 drawing goes to a RAM buffer that must be sent
+{
+	if (!(g_driver & DRIVER_MASK_SSD1306))
+		return;
+	if (headless)
+		headless->display();
+#ifdef ESP32
+	else
+		ssd1306->display();
+#endif
+}
+
+
+// static
+void myOledMonitor::refresh()
+{
+	update();
+}
+
+
+static void wakeUpdate()
+	// call update if no task, otherwise wake it up
+{
+	if (!g_with_task)
+		update();
+#ifdef ESP32
+	else if (update_task)
+		xTaskNotifyGive(update_task);
+#endif
+}
+
+
 static void update()
 {
 	static int last_counter;
-	if (last_counter == print_counter)
+	static int last_field_counter;
+	bool scroll_changed = last_counter != print_counter + view_counter;
+	bool fields_changed = last_field_counter != field_counter;
+	if (!scroll_changed && !fields_changed)
 		return;
-	last_counter = print_counter;
 
 	while (in_print) { delay(1); }
 
+	if (fields_changed)
+	{
+		last_field_counter = field_counter;
+		updateFields();
+	}
+	if (!scroll_changed)
+	{
+		showDisplay();
+		return;
+	}
+	last_counter = print_counter + view_counter;
+
+	if (sb_view)
+	{
+		updateScrollback();
+		showDisplay();
+		return;
+	}
+
 	int use_tail = tail;
 	int use_head = head;
-	int out_row = 0;
+	int out_row = pinned_rows;
 
 	#if DEBUG_SCREEN
 		display_fxn(0,0,"update(%d) use_tail(%d) use_head(%d)",last_counter,use_tail,use_head);
@@ -249,7 +478,7 @@ static void update()
 
 	if (use_tail > use_head)
 	{
-		while (use_tail < oled_rows+1)
+		while (use_tail < scroll_rows+1)
 		{
 			#if DEBUG_SCREEN
 				display_fxn(0,0,"tail_row(%d) use_tail(%d) s=%s",out_row,use_tail,buf_row(use_tail));
@@ -275,8 +504,7 @@ static void update()
 		out_row++;
 	}
 
-	if (g_driver & DRIVER_MASK_SSD1306)
-		ssd1306->display();
+	showDisplay();
 }
 
 
@@ -284,45 +512,388 @@ static void update()
 
 // static
 void myOledMonitor::println(const char *format, ...)
+	// formats directly into the next row of the circular buffer
 {
-	while (in_print) { delay(1); }
-	in_print = 1;
+	char *row = beginLine();
 
 	va_list var;
 	va_start(var, format);
-	char buffer[oled_cols + 1];
+	vsnprintf(row,oled_cols,format,var);
+	va_end(var);
 
-	vsnprintf(buffer,oled_cols,format,var);
-	int len = strlen(buffer);
+	endLine();
+}
+
+
+// static
+char *myOledMonitor::beginLine()
+{
+	while (in_print) { delay(1); }
+	in_print = 1;
+	return buf_row(head);
+}
+
+
+// static
+void myOledMonitor::endLine()
+{
+	char *row = buf_row(head);
+	int len = strlen(row);
 
 	if (g_with_display)
-		display_fxn(0,0,"mon(%d): %s",print_counter,buffer);
+		display_fxn(0,0,"mon(%d): %s",print_counter,row);
 	print_counter++;
 
 	if (len < oled_cols)
 	{
-		memset(&buffer[len],' ',oled_cols-len);
-		buffer[oled_cols] = 0;
+		memset(&row[len],' ',oled_cols-len);
+		row[oled_cols] = 0;
 	}
 
-	// put into circular buffer
+	// advance the circular buffer
 
-	strcpy(buf_row(head),buffer);
 	head++;
-	if (head >= oled_rows+1)
+	if (head >= scroll_rows+1)
 		head = 0;
 	if (tail == head)
 	{
 		tail++;
-		if (tail >= oled_rows+1)
+		if (tail >= scroll_rows+1)
 			tail = 0;
 	}
 
+	addHistory(row);
+
 	in_print = 0;
 	print_counter++;
 
-	// call update if no task
+	wakeUpdate();
+}
 
-	if (!g_with_task)
-		update();
+
+// static
+int myOledMonitor::getCols()
+{
+	return oled_cols;
+}
+
+
+
+//------------------------------------------------------
+// fields
+//------------------------------------------------------
+
+// static
+int myOledMonitor::addField(int row, int col, int width, const char *name/*=NULL*/, bool show_name/*=true*/)
+{
+	int name_len = name && show_name ? strlen(name) : 0;
+	if (num_fields >= MAX_OLED_FIELDS ||
+		row < 0 || row >= pinned_rows ||
+		col < 0 || width <= name_len ||
+		col + width > oled_cols)
+	{
+		display_fxn(0,0,"myOledMonitor::addField(%d,%d,%d,%s) does not fit",row,col,width,name?name:"");
+		return -1;
+	}
+
+	while (in_print) { delay(1); }
+	in_print = 1;
+
+	oledField_t *field = &fields[num_fields];
+	field->row = row;
+	field->col = col + name_len;
+	field->width = width - name_len;
+	field->name = name;
+	field->show_name = name_len;
+	field->name_dirty = name_len;
+	field->dirty_lo = 0;
+	field->dirty_hi = field->width - 1;
+	field->value = new char[field->width + 1];
+	memset(field->value,' ',field->width);
+	field->value[field->width] = 0;
+
+	in_print = 0;
+	field_counter++;
+	wakeUpdate();
+	return num_fields++;
+}
+
+
+// static
+int myOledMonitor::findField(const char *name)
+{
+	for (int i=0; i<num_fields; i++)
+	{
+		if (fields[i].name && !strcmp(fields[i].name,name))
+			return i;
+	}
+	return -1;
+}
+
+
+// static
+void myOledMonitor::setField(int field_num, const char *format, ...)
+{
+	if (field_num < 0 || field_num >= num_fields)
+		return;
+	oledField_t *field = &fields[field_num];
+
+	va_list var;
+	va_start(var, format);
+	char buffer[MAX_OLED_COLS + 1];		// width <= oled_cols
+	vsnprintf(buffer,field->width + 1,format,var);
+	va_end(var);
+	int len = strlen(buffer);
+	if (len < field->width)
+		memset(&buffer[len],' ',field->width-len);
+
+	// find the range of characters that changed
+
+	int lo = 0;
+	int hi = field->width - 1;
+	while (lo <= hi && buffer[lo] == field->value[lo]) lo++;
+	while (hi >= lo && buffer[hi] == field->value[hi]) hi--;
+	if (lo > hi)
+		return;
+
+	while (in_print) { delay(1); }
+	in_print = 1;
+
+	memcpy(&field->value[lo],&buffer[lo],hi-lo+1);
+	if (field->dirty_lo > field->dirty_hi)
+	{
+		field->dirty_lo = lo;
+		field->dirty_hi = hi;
+	}
+	else
+	{
+		if (lo < field->dirty_lo) field->dirty_lo = lo;
+		if (hi > field->dirty_hi) field->dirty_hi = hi;
+	}
+
+	in_print = 0;
+	field_counter++;
+	wakeUpdate();
+}
+
+
+static void updateFields()
+	// paint the changed part of each dirty field
+{
+	for (int i=0; i<num_fields; i++)
+	{
+		oledField_t *field = &fields[i];
+		int y = field->row * char_height;
+
+		if (field->name_dirty)
+		{
+			field->name_dirty = 0;
+			oled->setCursor((field->col - strlen(field->name)) * char_width, y);
+			oled->print(field->name);
+		}
+
+		int lo = field->dirty_lo;
+		int hi = field->dirty_hi;
+		if (lo > hi)
+			continue;
+		field->dirty_lo = field->width;
+		field->dirty_hi = -1;
+
+		oled->setCursor((field->col + lo) * char_width, y);
+		for (int j=lo; j<=hi; j++)
+			oled->write(field->value[j]);
+	}
+}
+
+
+
+//------------------------------------------------------
+// scrollback
+//------------------------------------------------------
+
+#define sb_wrap(pos)	((pos) >= sb_size ? (pos) - sb_size : (pos) < 0 ? (pos) + sb_size : (pos))
+
+
+static int sbPrevLine(int pos)
+	// returns the start of the line that ends at pos
+{
+	int len = sb_buf[sb_wrap(pos - 1)];
+	return sb_wrap(pos - len - 2);
+}
+
+
+static int sbDecode(int pos, char *buf, bool pad)
+	// decodes the line starting at pos into buf and
+	// returns the start of the next line
+{
+	int len = sb_buf[pos];
+	int out = 0;
+	pos = sb_wrap(pos + 1);
+	while (len--)
+	{
+		uint8_t c = sb_buf[pos];
+		pos = sb_wrap(pos + 1);
+		if (c >= SB_RUN)
+		{
+			int run = c - SB_RUN;
+			while (run-- && out < oled_cols)
+				buf[out++] = ' ';
+		}
+		else if (out < oled_cols)
+			buf[out++] = c;
+	}
+	if (pad)
+		while (out < oled_cols)
+			buf[out++] = ' ';
+	buf[out] = 0;
+	return sb_wrap(pos + 1);
+}
+
+
+static void addHistory(const char *line)
+	// called from println() with in_print set
+{
+	if (!sb_buf)
+		return;
+
+	// strip the padding, encode runs of three or more spaces,
+	// and map any high bit characters, which the font does
+	// not really support anyways, to '?'
+
+	uint8_t enc[255];
+	int len = strlen(line);
+	while (len && line[len-1] == ' ')
+		len--;
+
+	int n = 0;
+	int i = 0;
+	while (i < len && n < (int) sizeof(enc))
+	{
+		if (line[i] == ' ')
+		{
+			int run = 1;
+			while (i + run < len && line[i+run] == ' ' && run < 127)
+				run++;
+			if (run >= 3)
+			{
+				enc[n++] = SB_RUN + run;
+				i += run;
+				continue;
+			}
+		}
+		uint8_t c = line[i++];
+		enc[n++] = c >= SB_RUN ? '?' : c;
+	}
+
+	// drop the oldest lines until it fits
+
+	int need = n + 2;
+	if (need > sb_size)
+		return;
+	while (sb_size - sb_used < need)
+	{
+		int old_len = sb_buf[sb_tail] + 2;
+		sb_tail = sb_wrap(sb_tail + old_len);
+		sb_used -= old_len;
+		sb_lines--;
+	}
+
+	sb_buf[sb_head] = n;
+	sb_head = sb_wrap(sb_head + 1);
+	for (i=0; i<n; i++)
+	{
+		sb_buf[sb_head] = enc[i];
+		sb_head = sb_wrap(sb_head + 1);
+	}
+	sb_buf[sb_head] = n;
+	sb_head = sb_wrap(sb_head + 1);
+	sb_used += need;
+	sb_lines++;
+
+	// keep the window where it is if scrolled back
+
+	if (sb_view)
+	{
+		int max_view = sb_lines - scroll_rows;
+		if (sb_view < max_view)
+			sb_view++;
+		else
+			sb_view = max_view > 0 ? max_view : 0;
+	}
+}
+
+
+static void updateScrollback()
+	// paint the history window, oldest line at the top
+{
+	int count = scroll_rows;
+	if (sb_view + count > sb_lines)
+		count = sb_lines - sb_view;
+
+	int pos = sb_head;
+	for (int i=0; i<sb_view + count; i++)
+		pos = sbPrevLine(pos);
+
+	for (int row=0; row<scroll_rows; row++)
+	{
+		if (row < count)
+			pos = sbDecode(pos,sb_row,true);
+		else
+		{
+			memset(sb_row,' ',oled_cols);
+			sb_row[oled_cols] = 0;
+		}
+		oled->setCursor(0,(pinned_rows + row) * char_height);
+		oled->print(sb_row);
+	}
+}
+
+
+// static
+int myOledMonitor::getHistoryLines()
+{
+	return sb_lines;
+}
+
+
+// static
+bool myOledMonitor::getHistoryLine(int back, char *buf)
+{
+	while (in_print) { delay(1); }
+	in_print = 1;
+
+	bool ok = back >= 0 && back < sb_lines;
+	if (ok)
+	{
+		int pos = sb_head;
+		for (int i=0; i<=back; i++)
+			pos = sbPrevLine(pos);
+		sbDecode(pos,buf,false);
+	}
+
+	in_print = 0;
+	return ok;
+}
+
+
+// static
+void myOledMonitor::scrollBack(int lines)
+{
+	int max_view = sb_lines - scroll_rows;
+	if (lines > max_view)
+		lines = max_view;
+	if (lines < 0)
+		lines = 0;
+	if (lines == sb_view)
+		return;
+	sb_view = lines;
+	view_counter++;
+	wakeUpdate();
+}
+
+
+// static
+int myOledMonitor::getScrollBack()
+{
+	return sb_view;
 }
@@ -4,17 +4,50 @@
 // Simple library to drive (ideaSpark) SSD1306 or ST7789
 // display as a scrolling text output monitor.
 // Implemented and Tested on ESP32 using default CS(15)
+//
+// OR'ing DRIVER_HEADLESS into the driver renders into an in-memory
+// myOledHeadless surface with the geometry and bus model of the
+// given display. That is the only driver available in a host
+// (non ESP32) build, which init() uses even if it was not given,
+// and which has no update task either, so the client calls
+// refresh() itself if with_task is set.
+//
+// The top of the screen may be reserved with setPinnedRows() for
+// fixed fields that are updated in place with setField(), with the
+// scrolling log in the rows below them. Only the characters of a
+// field that actually changed are repainted.
+//
+// setScrollback() keeps a compressed history of lines that have
+// scrolled off the screen in a fixed RAM budget (PSRAM if present)
+// that may be paged through with scrollBack().
 
 #pragma once
 
 #include <Arduino.h>
 
+class myOledHeadless;
+
 #define DRIVER_SSD1306_128x32	0x0100		// I2C
 #define DRIVER_SSD1306_128x64	0x0110		// I2C
 #define DRIVER_ST7789_320x170	0x0200		// SPI
 
 #define DRIVER_MASK_SSD1306		0x0100
 #define DRIVER_MASK_ST7789		0x0200
+#define DRIVER_HEADLESS			0x0800		// in-memory, no hardware
+
+// update task defaults, may be overriden with setTaskParams() before init()
+
+#ifndef OLED_TASK_CORE
+	#define OLED_TASK_CORE			1		// ESP32_CORE_ARDUINO
+#endif
+#ifndef OLED_TASK_PRIORITY
+	#define OLED_TASK_PRIORITY		5
+#endif
+#ifndef OLED_MAX_FPS
+	#define OLED_MAX_FPS			20		// 0 = no frame rate cap
+#endif
+
+#define MAX_OLED_FIELDS				16
 
 
 class myOledMonitor
@@ -23,8 +56,61 @@ public:
 
 	myOledMonitor(uint16_t driver, int font_size=2, bool with_task=false);
 
+	static void setTaskParams(int core, int priority, int max_fps=OLED_MAX_FPS);
+		// must be called before init() to have any effect.
+		// The task sleeps until println() notifies it, then
+		// paints all lines queued since the last frame, at
+		// no more than max_fps frames per second.
+
 	static void init(int rotation=0, bool with_display=false);
 
 	static void println(const char *format, ...);
 
+	static char *beginLine();
+	static void endLine();
+		// for formatting directly into the next row, i.e. with
+		// myFastFormat. beginLine() returns the row, which holds
+		// getCols() characters plus a terminating zero, and locks
+		// the monitor until endLine() pads and shows it.
+	static int getCols();
+
+	static void setPinnedRows(int num_rows);
+		// must be called before init(); reserves num_rows at the
+		// top of the screen for fields. The scrolling log gets the rest.
+	static int addField(int row, int col, int width, const char *name=NULL, bool show_name=true);
+		// call after init(); defines a field of width characters, including
+		// the name if shown, at col in pinned row, and returns a handle
+		// for setField(), or -1 if it does not fit. A full width field
+		// is a status row.
+	static int findField(const char *name);
+		// returns the handle of the named field or -1
+	static void setField(int field, const char *format, ...);
+		// formats the value into the field, truncating or padding with
+		// spaces, and repaints only the characters that changed
+
+	static void setScrollback(int num_bytes, bool use_psram=true);
+		// takes effect at the next init(), which reallocates it if
+		// the size changed; a fixed num_bytes history, dropping the
+		// oldest lines when full.
+		// Lines are stored without the trailing padding and with runs
+		// of spaces run-length encoded, typically 10-20 bytes per line.
+	static int getHistoryLines();
+		// number of lines currently in the history
+	static bool getHistoryLine(int back, char *buf);
+		// decodes the back'th most recent line (0 = newest) into buf,
+		// which must hold a full row (columns+1), without padding.
+	static void scrollBack(int lines);
+		// shows the history window ending lines before the newest line.
+		// 0 returns to the live display. The window stays put as new
+		// lines arrive while scrolled back.
+	static int getScrollBack();
+
+	static void refresh();
+		// paint any lines printed since the last frame.
+		// Normally called from println() or the update task.
+
+	static myOledHeadless *getHeadless();
+		// returns NULL unless DRIVER_HEADLESS was specified,
+		// or this is a host build
+
 };
@@ -0,0 +1,74 @@
+//---------------------------------------------
+// myOneWire.h
+//---------------------------------------------
+// A OneWire bus interface for myTempSensor, so that it can
+// run against the real OneWire library on any Arduino board, or
+// against the simulated bus in extras/tsenseSim on a Linux host,
+// where extras/host/Arduino.h defines MY_HOST_BUILD.
+//
+// The methods are those of the OneWire library that myTempSensor
+// uses, with the same semantics.
+
+#pragma once
+
+#include <Arduino.h>
+
+
+class myOneWire
+{
+public:
+
+	virtual ~myOneWire() {}
+
+	virtual uint8_t reset() = 0;
+		// returns 1 if any device answered with a presence pulse
+	virtual void select(const uint8_t *rom) = 0;
+	virtual void skip() = 0;
+	virtual void write(uint8_t v, uint8_t power=0) = 0;
+	virtual uint8_t read() = 0;
+	virtual void write_bit(uint8_t v) = 0;
+	virtual uint8_t read_bit() = 0;
+	virtual void depower() = 0;
+
+	virtual void reset_search() = 0;
+	virtual bool search(uint8_t *addr, bool search_mode=true) = 0;
+		// search_mode false does a conditional (alarm) search
+
+	static uint8_t crc8(const uint8_t *addr, uint8_t len);
+		// Dallas/Maxim CRC-8
+};
+
+
+
+#ifndef MY_HOST_BUILD
+
+#include <OneWire.h>
+
+class myOneWireHW : public myOneWire
+	// the real thing
+{
+public:
+
+	myOneWireHW() {}
+	myOneWireHW(uint8_t pin) : m_one_wire(pin) {}
+
+	void begin(uint8_t pin)  { m_one_wire.begin(pin); }
+
+	uint8_t reset() override  						{ return m_one_wire.reset(); }
+	void select(const uint8_t *rom) override  		{ m_one_wire.select(rom); }
+	void skip() override  							{ m_one_wire.skip(); }
+	void write(uint8_t v, uint8_t power=0) override	{ m_one_wire.write(v,power); }
+	uint8_t read() override  						{ return m_one_wire.read(); }
+	void write_bit(uint8_t v) override  			{ m_one_wire.write_bit(v); }
+	uint8_t read_bit() override  					{ return m_one_wire.read_bit(); }
+	void depower() override  						{ m_one_wire.depower(); }
+	void reset_search() override  					{ m_one_wire.reset_search(); }
+	bool search(uint8_t *addr, bool search_mode=true) override
+		{ return m_one_wire.search(addr,search_mode); }
+
+private:
+
+	OneWire m_one_wire;
+};
+
+#endif	// !MY_HOST_BUILD
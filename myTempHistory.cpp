@@ -0,0 +1,154 @@
+//---------------------------------------------
+// myTempHistory.cpp
+//---------------------------------------------
+
+#include "myTempHistory.h"
+
+
+static const uint32_t rollup_periods[] = TSENSE_ROLLUP_PERIODS;
+
+static_assert(sizeof(rollup_periods) / sizeof(rollup_periods[0]) == TSENSE_ROLLUP_LEVELS,
+	"TSENSE_ROLLUP_PERIODS must have TSENSE_ROLLUP_LEVELS periods");
+
+
+myTempHistory::myTempHistory()
+{
+	clear();
+}
+
+
+void myTempHistory::clear()
+{
+	m_seq++;
+	__sync_synchronize();
+	m_head = 0;
+	m_num = 0;
+	memset(m_levels,0,sizeof(m_levels));
+	__sync_synchronize();
+	m_seq++;
+}
+
+
+// static
+uint32_t myTempHistory::getPeriod(int level)
+{
+	if (level < 0 || level >= TSENSE_ROLLUP_LEVELS)
+		return 0;
+	return rollup_periods[level];
+}
+
+
+void myTempHistory::addBucket(int level, const bucket_t *bucket, uint32_t time)
+	// folds a sample, or a closed bucket of the previous level
+	// that started at time, into the open bucket of the level
+{
+	level_t *lvl = &m_levels[level];
+	uint32_t index = time / rollup_periods[level];
+
+	if (lvl->open.count && lvl->open.index != index)
+	{
+		bucket_t closed = lvl->open;
+		lvl->ring[lvl->head] = closed;
+		lvl->head = (lvl->head + 1) % TSENSE_ROLLUP_DEPTH;
+		if (lvl->num < TSENSE_ROLLUP_DEPTH)
+			lvl->num++;
+		lvl->open.count = 0;
+
+		if (level + 1 < TSENSE_ROLLUP_LEVELS)
+			addBucket(level + 1,&closed,closed.index * rollup_periods[level]);
+	}
+
+	bucket_t *open = &lvl->open;
+	if (!open->count)
+	{
+		open->min = bucket->min;
+		open->max = bucket->max;
+		open->sum = 0;
+		open->index = index;
+	}
+	else
+	{
+		if (bucket->min < open->min)
+			open->min = bucket->min;
+		if (bucket->max > open->max)
+			open->max = bucket->max;
+	}
+	open->sum += bucket->sum;
+	open->count += bucket->count;
+}
+
+
+void myTempHistory::add(int16_t raw, uint32_t time)
+{
+	m_seq++;
+	__sync_synchronize();
+
+	m_samples[m_head] = raw;
+	m_head = (m_head + 1) % TSENSE_HISTORY_DEPTH;
+	if (m_num < TSENSE_HISTORY_DEPTH)
+		m_num++;
+
+	bucket_t sample;
+	sample.min = raw;
+	sample.max = raw;
+	sample.sum = raw;
+	sample.count = 1;
+	addBucket(0,&sample,time);
+
+	__sync_synchronize();
+	m_seq++;
+}
+
+
+int myTempHistory::getSamples(int16_t *buf, int max) const
+{
+	int n;
+	uint32_t seq;
+	do
+	{
+		seq = m_seq;
+		__sync_synchronize();
+		n = m_num < max ? m_num : max;
+		int pos = m_head;
+		for (int i=0; i<n; i++)
+		{
+			pos = pos ? pos - 1 : TSENSE_HISTORY_DEPTH - 1;
+			buf[i] = m_samples[pos];
+		}
+		__sync_synchronize();
+	}	while ((seq & 1) || seq != m_seq);
+	return n;
+}
+
+
+bool myTempHistory::getRollup(int level, int back, tsenseRollup_t *rollup) const
+{
+	if (level < 0 || level >= TSENSE_ROLLUP_LEVELS ||
+		back < 0 || back > TSENSE_ROLLUP_DEPTH)
+		return false;
+
+	const level_t *lvl = &m_levels[level];
+	bucket_t copy = {};
+	uint32_t seq;
+	do
+	{
+		seq = m_seq;
+		__sync_synchronize();
+		if (!back)
+			copy = lvl->open;
+		else if (back > lvl->num)
+			copy.count = 0;
+		else
+			copy = lvl->ring[(lvl->head + TSENSE_ROLLUP_DEPTH - back) % TSENSE_ROLLUP_DEPTH];
+		__sync_synchronize();
+	}	while ((seq & 1) || seq != m_seq);
+
+	if (!copy.count)
+		return false;
+	rollup->min = copy.min;
+	rollup->max = copy.max;
+	rollup->mean = copy.sum / copy.count;
+	rollup->count = copy.count;
+	rollup->time = copy.index * rollup_periods[level];
+	return true;
+}
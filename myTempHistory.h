@@ -0,0 +1,103 @@
+//---------------------------------------------
+// myTempHistory.h
+//---------------------------------------------
+// A fixed size history of the raw 1/128 degree C readings of one
+// temperature sensor, kept by myTempSensor for each device.
+//
+// It keeps a ring of the last TSENSE_HISTORY_DEPTH samples, and
+// cascaded min/max/mean rollups over TSENSE_ROLLUP_LEVELS periods,
+// by default 1 second, 1 minute and 1 hour, with a ring of the last
+// TSENSE_ROLLUP_DEPTH closed buckets for each period. Overriding
+// TSENSE_ROLLUP_LEVELS needs a TSENSE_ROLLUP_PERIODS with as many.
+//
+// Each sample goes into the open bucket of the first level. When a
+// sample falls into a new period, the open bucket is closed into the
+// ring, and folded into the open bucket of the next level, which
+// may in turn close, so a sample costs at most one update per level.
+// All of the memory is in the object, so the RAM budget is fixed at
+// compile time: about 2 * HISTORY_DEPTH + 16 * LEVELS * (ROLLUP_DEPTH+1)
+// bytes per device.
+//
+// A bucket holds at most 65535 samples, which is one sample about
+// every 55ms for the default 1 hour level.
+//
+// add() is called by myTempSensor::loop(); the getters may be
+// called from any task, and retry if a sample is added under them.
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef TSENSE_HISTORY_DEPTH
+	#define TSENSE_HISTORY_DEPTH	32		// samples per device
+#endif
+#ifndef TSENSE_ROLLUP_DEPTH
+	#define TSENSE_ROLLUP_DEPTH		8		// closed buckets per level
+#endif
+#ifndef TSENSE_ROLLUP_LEVELS
+	#define TSENSE_ROLLUP_LEVELS	3
+#endif
+#ifndef TSENSE_ROLLUP_PERIODS
+	#define TSENSE_ROLLUP_PERIODS	{ 1000, 60000, 3600000 }	// ms per level
+#endif
+
+
+typedef struct
+{
+	int16_t min;			// 1/128 degrees C
+	int16_t max;
+	int16_t mean;
+	uint16_t count;			// number of samples; 0 if none
+	uint32_t time;			// millis() at the start of the period
+} tsenseRollup_t;
+
+
+class myTempHistory
+{
+public:
+
+	myTempHistory();
+
+	void clear();
+	void add(int16_t raw, uint32_t time);
+		// adds a sample taken at millis() time
+
+	int getSamples(int16_t *buf, int max) const;
+		// copies up to max samples, newest first, and
+		// returns the number copied
+	bool getRollup(int level, int back, tsenseRollup_t *rollup) const;
+		// back == 0 is the open bucket of the current period, 1 the
+		// last closed one, and so on. Returns false if level or back
+		// are out of range or there is no such bucket yet.
+	static uint32_t getPeriod(int level);
+		// ms per bucket of the level
+
+
+private:
+
+	typedef struct
+	{
+		int16_t min;
+		int16_t max;
+		int32_t sum;
+		uint16_t count;
+		uint32_t index;		// time / period
+	} bucket_t;
+
+	typedef struct
+	{
+		bucket_t open;
+		bucket_t ring[TSENSE_ROLLUP_DEPTH];
+		uint8_t head;		// next ring slot
+		uint8_t num;		// closed buckets in the ring
+	} level_t;
+
+	volatile uint32_t m_seq;	// odd while being written
+	int16_t m_samples[TSENSE_HISTORY_DEPTH];
+	uint16_t m_head;			// next sample slot
+	uint16_t m_num;
+	level_t m_levels[TSENSE_ROLLUP_LEVELS];
+
+	void addBucket(int level, const bucket_t *bucket, uint32_t time);
+
+};
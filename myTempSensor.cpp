@@ -18,12 +18,24 @@
 // So I rewrote it for me.
 
 #include "myTempSensor.h"
-#include <OneWire.h>
+#include "myOneWire.h"
+#include "myFastFormat.h"
 #include <myDebug.h>
 
 
 #define PENDING_TIMEOUT	800
-	// 750 plus some wiggle room
+	// 750 plus some wiggle room, used until the resolutions are known
+
+#define CONVERSION_MARGIN	50
+	// wiggle room for lower resolutions
+
+#define COPYSCRATCH_MS		10
+	// EEPROM write time
+
+#define TSENSE_REREAD		-1
+	// from checkFast() for all ones, which is what a device that did
+	// not answer reads as, but also a good -0.0625C, so it is read
+	// again in full, without counting it against the device
 
 #define DEBUG_ADDR	0
 #define DEBUG_SENSE 0
@@ -40,6 +52,7 @@
 #define DS28EA00MODEL 	0x42
 
 // OneWire commands
+#define MATCHROM        0x55  // Select a device by ROM address
 #define STARTCONVO      0x44  // Tells device to take a temperature reading and put it on the scratchpad
 #define COPYSCRATCH     0x48  // Copy scratchpad to EEPROM
 #define READSCRATCH     0xBE  // Read from scratchpad
@@ -69,8 +82,6 @@
 #define TEMP_11_BIT 	0x5F // 11 bit
 #define TEMP_12_BIT 	0x7F // 12 bit
 
-OneWire	one_wire;
-
 typedef uint8_t ScratchPad[9];
 const ScratchPad  empty_pad = {0,0,0,0,0,0,0,0,0};
 
@@ -98,11 +109,65 @@ static const char *KNOWN_SENSORS[] = {
 #define NUM_KNOWN_SENSORS		(sizeof(KNOWN_SENSORS)/sizeof(uint8_t *))
 
 
-myTempSensor::myTempSensor(int one_wire_pin) :
+// sweep states
+
+#define SWEEP_IDLE		0
+#define SWEEP_CONVERT	1
+#define SWEEP_WAIT		2
+#define SWEEP_RESET		3
+#define SWEEP_XFER		4
+#define SWEEP_DONE		5
+#define SWEEP_SCAN		6		// reset and SEARCHROM
+#define SWEEP_SCAN_BITS	7		// search triplets
+
+#define SEARCHROM       0xF0
+
+
+#ifndef MY_HOST_BUILD
+	myTempSensor::myTempSensor(int one_wire_pin) :
+		myTempSensor(new myOneWireHW(one_wire_pin))
+	{
+		m_own_bus = 1;
+	}
+#endif
+
+
+myTempSensor::myTempSensor(myOneWire *bus) :
+	m_bus(bus),
+	m_own_bus(0),
 	m_pending(0),
-	m_last_error(0)
+	m_last_error(0),
+	m_parasite(0),
+	m_poll_ready(1),
+	m_conversion_ms(PENDING_TIMEOUT),
+	m_read_mode(TSENSE_READ_FULL),
+	m_num_devices(0),
+	m_sweeping(0),
+	m_sweep_state(SWEEP_IDLE),
+	m_sweep_interval(0),
+	m_sweep_start(0),
+	m_sweep_count(0),
+	m_sweep_dev(0),
+	m_sweep_retry(0),
+	m_alarm_sweeps(0),
+	m_sweep_alarm(0),
+	m_rescan_interval(0),
+	m_rescan_start(0),
+	m_rescan_count(0),
+	m_event_head(0),
+	m_event_tail(0),
+	m_err_logged(0)
+{
+	memset(m_snapshots,0,sizeof(m_snapshots));
+	memset(m_err_time,0,sizeof(m_err_time));
+	memset(m_err_suppressed,0,sizeof(m_err_suppressed));
+}
+
+
+myTempSensor::~myTempSensor()
 {
-	one_wire.begin(one_wire_pin);
+	if (m_own_bus)
+		delete m_bus;
 }
 
 
@@ -115,6 +180,7 @@ const char *myTempSensor::errString(int err)
 {
 	switch (err)
 	{
+		case TSENSE_OK					: return "OK";
 		case TSENSE_ERROR_NO_DEVICES	: return "NO_DEVICES";
 		case TSENSE_ERROR_OFFLINE		: return "OFFLINE";
 		case TSENSE_ERROR_EMPTY_DATA	: return "EMPTY_DATA";
@@ -122,22 +188,21 @@ const char *myTempSensor::errString(int err)
 		case TSENSE_ERROR_BAD_CRC		: return "BAD_CRC";
 		case TSENSE_ERROR_BAD_CONFIG	: return "BAD_CONFIG";
 		case TSENSE_ERROR_PENDING		: return "PENDING";
+		case TSENSE_ERROR_SUSPECT		: return "SUSPECT";
 	}
 	return "UNKNOWN";
 }
 
 
-static String addrToStr(const uint8_t *addr)
+static const char *addrToStr(const uint8_t *addr, char *buf)
+	// buf must hold 17 characters; in the same
+	// upper case format as KNOWN_SENSORS
 {
-	String rslt = "";
+	myFastFormat fmt(buf,16);
 	for (int i=0; i<8; i++)
-	{
-		String hex = String(addr[i],HEX);
-		if (hex.length() == 1)
-			hex = "0" + hex;
-		rslt += hex;
-	}
-	return rslt;
+		fmt.hex<2>(addr[i]);
+	fmt.end();
+	return buf;
 }
 
 
@@ -155,8 +220,9 @@ static void strToAddr(uint8_t *addr, const char *saddr)
 	for (int i=0; i<8; i++)
 	{
 		addr[i] =
-			(hexDigitValue(*ptr++) << 4) |
-			hexDigitValue(*ptr++);
+			(hexDigitValue(ptr[0]) << 4) |
+			hexDigitValue(ptr[1]);
+		ptr += 2;
 	}
 
 	#if DEBUG_ADDR
@@ -176,19 +242,41 @@ static void strToAddr(uint8_t *addr, const char *saddr)
 
 static int findKnownSensor(const uint8_t *addr)
 {
-	for (int i=0; i<NUM_KNOWN_SENSORS; i++)
+	// the strings are only parsed once
+
+	static bool known_parsed;
+	static uint8_t known_addrs[NUM_KNOWN_SENSORS][8];
+	if (!known_parsed)
+	{
+		for (int i=0; i<(int) NUM_KNOWN_SENSORS; i++)
+			strToAddr(known_addrs[i], KNOWN_SENSORS[i]);
+		known_parsed = 1;
+	}
+
+	for (int i=0; i<(int) NUM_KNOWN_SENSORS; i++)
 	{
-		uint8_t known_addr[8];
-		strToAddr(known_addr, KNOWN_SENSORS[i]);
-		if (!memcmp(addr,known_addr,8))
+		if (!memcmp(addr,known_addrs[i],8))
 			return i+1;
 	}
-	my_error("Could not find KNOWN_SENSOR(%s)",addrToStr(addr).c_str());
+	char buf[17];
+	my_error("Could not find KNOWN_SENSOR(%s)",addrToStr(addr,buf));
 	return 0;
 }
 
 
 
+static bool validFamily(uint8_t family)
+{
+	return
+		family == DS18S20MODEL ||
+		family == DS18B20MODEL ||
+		family == DS1822MODEL  ||
+		family == DS1825MODEL  ||
+		family == DS28EA00MODEL;
+}
+
+
+
 //-----------------------------
 // implementation
 //-----------------------------
@@ -232,34 +320,32 @@ int myTempSensor::init()
 	proc_entry();
 
 	m_last_error = 0;
+	m_num_devices = 0;
 
 	uint8_t addr[8];
+	char buf[17];
 
 	int num_found = 0;
-	one_wire.reset_search();
-	while (one_wire.search(addr))
+	m_bus->reset_search();
+	while (m_bus->search(addr))
 	{
-		if (OneWire::crc8(addr, 7) == addr[DSROM_CRC])
+		if (myOneWire::crc8(addr, 7) == addr[DSROM_CRC])
 		{
-			bool valid_family =
-				addr[DSROM_FAMILY] == DS18S20MODEL ||
-				addr[DSROM_FAMILY] == DS18B20MODEL ||
-				addr[DSROM_FAMILY] == DS1822MODEL  ||
-				addr[DSROM_FAMILY] == DS1825MODEL  ||
-				addr[DSROM_FAMILY] == DS28EA00MODEL;
-
-			if (valid_family)
+			if (validFamily(addr[DSROM_FAMILY]))
 			{
 				num_found++;
 
 				int known = findKnownSensor(addr);
 				int res = getResolution(addr);
 				display(0,"known(%d) res(%d) {%s} ",
-					known,res,addrToStr(addr).c_str());
+					known,res,addrToStr(addr,buf));
+
+				if (addDevice(addr,known,res) < 0)
+					warning(0,"MAX_TSENSE_DEVICES(%d) exceeded",MAX_TSENSE_DEVICES);
 			}
 			else
 			{
-				warning(0,"tSense.cpp INVALID FAMILY: %s",addrToStr(addr).c_str());
+				warning(0,"tSense.cpp INVALID FAMILY: %s",addrToStr(addr,buf));
 					// only a warning on the assumption the bus might
 					// contain other valid OneWire devices
 			}
@@ -271,6 +357,10 @@ int myTempSensor::init()
 	if (!m_last_error && !num_found)
 		tsenseError(TSENSE_ERROR_NO_DEVICES,NULL);
 
+	m_parasite = num_found && !readPowerSupply();
+	setConversionMs();
+	display(0,"parasite(%d) conversion_ms(%d)",m_parasite,m_conversion_ms);
+
 	measure();
 	proc_leave();
 
@@ -280,9 +370,22 @@ int myTempSensor::init()
 
 
 bool myTempSensor::pending()
+	// With external power, read slots return 0 while any
+	// device is still converting, and 1 when they are all done.
+	// This only works because nothing else touches the bus
+	// between the STARTCONVO and the end of pending().
 {
-	if (m_pending && millis() - m_pending > PENDING_TIMEOUT)
-		m_pending = 0;
+	if (m_pending)
+	{
+		if (millis() - m_pending > m_conversion_ms)
+		{
+			m_pending = 0;
+			if (m_parasite)
+				m_bus->depower();		// end the strong pullup
+		}
+		else if (m_poll_ready && !m_parasite && m_bus->read_bit())
+			m_pending = 0;
+	}
 	return m_pending;
 }
 
@@ -299,11 +402,13 @@ int myTempSensor::measure()
 	if (pending())
 		return tsenseError(TSENSE_ERROR_PENDING,NULL);
 
-	if (!one_wire.reset())
+	if (!m_bus->reset())
 		return tsenseError(TSENSE_ERROR_NO_DEVICES,NULL);
 
-	one_wire.skip();
-	one_wire.write(STARTCONVO, 0);	// 0 == parasite
+	m_bus->skip();
+	m_bus->write(STARTCONVO, m_parasite);
+		// with a strong pullup to power parasite devices,
+		// until pending() sees the conversion time go by
 	m_pending = millis();
 
 	return TSENSE_OK;
@@ -321,6 +426,10 @@ float myTempSensor::getDegreesC(const char *saddr)
 
 	uint8_t addr[8];
 	strToAddr(addr,saddr);
+	int handle = findDevice(addr);
+	if (handle >= 0)
+		return getDegreesC(handle);
+
 	if (pending())
 	{
 		tsenseError(TSENSE_ERROR_PENDING,addr);
@@ -335,19 +444,308 @@ float myTempSensor::getDegreesC(const char *saddr)
 }
 
 
+float myTempSensor::getDegreesC(int handle)
+{
+	m_last_error = 0;
+
+	if (handle < 0 || handle >= m_num_devices)
+	{
+		tsenseError(TSENSE_ERROR_BAD_ADDR,NULL);
+		return TEMPERATURE_ERROR;
+	}
+
+	tsenseDevice_t *dev = &m_devices[handle];
+	if (pending())
+	{
+		dev->status = tsenseError(TSENSE_ERROR_PENDING,dev->addr);
+		return TEMPERATURE_ERROR;
+	}
+
+	if (readDevice(handle) != TSENSE_OK)
+		return TEMPERATURE_ERROR;
+	return (float) dev->raw * 0.0078125f;
+}
+
+
+int myTempSensor::readAll(int16_t *raw, uint8_t *status, int max)
+{
+	m_last_error = 0;
+	int n = m_num_devices < max ? m_num_devices : max;
+	bool busy = pending();
+	if (busy)
+		tsenseError(TSENSE_ERROR_PENDING,NULL);
+
+	for (int i=0; i<n; i++)
+	{
+		tsenseDevice_t *dev = &m_devices[i];
+		int rslt =
+			busy ? TSENSE_ERROR_PENDING :
+			!dev->online ? TSENSE_ERROR_OFFLINE :
+			readDevice(i);
+		raw[i] = dev->raw;
+		status[i] = rslt;
+	}
+	return n;
+}
+
+
+int myTempSensor::getSnapshots(int16_t *raw, uint8_t *status, int max)
+{
+	int n = m_num_devices < max ? m_num_devices : max;
+	for (int i=0; i<n; i++)
+	{
+		raw[i] = 0;
+		if (!getSnapshot(i,&raw[i],&status[i]))
+			status[i] = TSENSE_ERROR_PENDING;
+	}
+	return n;
+}
+
+
+bool myTempSensor::useFullRead(tsenseDevice_t *dev)
+{
+	if (m_read_mode == TSENSE_READ_FULL ||
+		dev->family == DS18S20MODEL)
+		return true;
+	if (m_read_mode == TSENSE_READ_FAST)
+		return false;
+	return dev->full_reads || !(++dev->reads % TSENSE_AUDIT_READS);
+}
+
+
+int myTempSensor::readDevice(int handle)
+{
+	tsenseDevice_t *dev = &m_devices[handle];
+	ScratchPad scratch_pad;
+	bool full = useFullRead(dev);
+	int rslt = full ?
+		readScratchPad(dev->addr, scratch_pad) :
+		readFast(dev->addr, scratch_pad);
+	if (rslt == TSENSE_REREAD)
+	{
+		full = 1;
+		rslt = readScratchPad(dev->addr, scratch_pad);
+	}
+	rslt = finishRead(handle,full,scratch_pad,rslt);
+
+	// confirm a suspect fast read right away
+
+	if (rslt == TSENSE_ERROR_SUSPECT)
+		rslt = finishRead(handle,true,scratch_pad,
+			readScratchPad(dev->addr, scratch_pad));
+	return rslt;
+}
+
+
+int myTempSensor::finishRead(int handle, bool full, const uint8_t *scratch_pad, int rslt)
+{
+	tsenseDevice_t *dev = &m_devices[handle];
+	int16_t raw = 0;
+	if (rslt == TSENSE_OK)
+	{
+		raw = calculateRaw(dev->addr,scratch_pad);
+		if (!full &&
+			dev->status == TSENSE_OK &&
+			abs(raw - dev->raw) > TSENSE_MAX_JUMP)
+			rslt = tsenseError(TSENSE_ERROR_SUSPECT,dev->addr);
+	}
+
+	if (m_read_mode == TSENSE_READ_ADAPTIVE)
+	{
+		if (rslt != TSENSE_OK)
+		{
+			int score = dev->err_score + (rslt == TSENSE_ERROR_SUSPECT ?
+				TSENSE_ERROR_LIMIT : TSENSE_ERROR_LIMIT / 2);
+			dev->err_score = score > 255 ? 255 : score;
+			if (dev->err_score >= TSENSE_ERROR_LIMIT)
+				dev->full_reads = 1;
+		}
+		else if (full && dev->err_score)
+		{
+			if (!--dev->err_score)
+				dev->full_reads = 0;
+		}
+	}
+
+	dev->status = rslt;
+	if (rslt == TSENSE_OK)
+		dev->raw = raw;
+	return rslt;
+}
+
+
+int myTempSensor::setResolution(int handle, int bits, bool persist/*=false*/)
+{
+	m_last_error = 0;
+	if (bits < 9 || bits > 12)
+		return tsenseError(TSENSE_ERROR_BAD_CONFIG,NULL);
+	if (handle < -1 || handle >= m_num_devices)
+		return tsenseError(TSENSE_ERROR_BAD_ADDR,NULL);
+	if (pending())
+		return tsenseError(TSENSE_ERROR_PENDING,NULL);
+
+	static const uint8_t configs[] = { TEMP_9_BIT, TEMP_10_BIT, TEMP_11_BIT, TEMP_12_BIT };
+	uint8_t config = configs[bits - 9];
+
+	int first = handle == -1 ? 0 : handle;
+	int last = handle == -1 ? m_num_devices - 1 : handle;
+	for (int i=first; i<=last; i++)
+	{
+		tsenseDevice_t *dev = &m_devices[i];
+		if (dev->family == DS18S20MODEL)
+			continue;
+
+		// preserve the alarm bytes
+
+		ScratchPad scratch_pad;
+		if (readScratchPad(dev->addr,scratch_pad) != TSENSE_OK)
+			continue;
+		if (writeScratchPad(dev->addr,
+				scratch_pad[HIGH_ALARM_TEMP],
+				scratch_pad[LOW_ALARM_TEMP],
+				config,persist) != TSENSE_OK)
+			continue;
+		dev->resolution = getResolution(dev->addr);
+	}
+
+	setConversionMs();
+	return m_last_error;
+}
+
+
+int myTempSensor::setAlarms(int handle, int8_t high_c, int8_t low_c, bool persist/*=false*/)
+{
+	m_last_error = 0;
+	if (high_c < low_c)
+		return tsenseError(TSENSE_ERROR_BAD_CONFIG,NULL);
+	if (handle < -1 || handle >= m_num_devices)
+		return tsenseError(TSENSE_ERROR_BAD_ADDR,NULL);
+	if (pending())
+		return tsenseError(TSENSE_ERROR_PENDING,NULL);
+
+	int first = handle == -1 ? 0 : handle;
+	int last = handle == -1 ? m_num_devices - 1 : handle;
+	for (int i=first; i<=last; i++)
+	{
+		tsenseDevice_t *dev = &m_devices[i];
+
+		// preserve the configuration byte
+
+		ScratchPad scratch_pad;
+		if (readScratchPad(dev->addr,scratch_pad) != TSENSE_OK)
+			continue;
+		writeScratchPad(dev->addr,high_c,low_c,
+			scratch_pad[CONFIGURATION],persist);
+	}
+
+	return m_last_error;
+}
+
+
+void myTempSensor::setConversionMs()
+	// 750ms at 12 bits, halving for each bit less
+{
+	int max_res = 0;
+	for (int i=0; i<m_num_devices; i++)
+	{
+		int res = m_devices[i].resolution;
+		if (!res)
+			res = 12;
+		if (res > max_res)
+			max_res = res;
+	}
+	m_conversion_ms = max_res ?
+		(750 >> (12 - max_res)) + CONVERSION_MARGIN :
+		PENDING_TIMEOUT;
+}
+
+
+int myTempSensor::getHandle(const char *saddr)
+{
+	uint8_t addr[8];
+	strToAddr(addr,saddr);
+	return findDevice(addr);
+}
+
+
+const tsenseDevice_t *myTempSensor::getDevice(int handle)
+{
+	if (handle < 0 || handle >= m_num_devices)
+		return NULL;
+	return &m_devices[handle];
+}
+
+
 
 //-------------------------------------------------
 // private
 //-------------------------------------------------
 
+int myTempSensor::addDevice(const uint8_t *addr, int known, int res)
+{
+	if (m_num_devices >= MAX_TSENSE_DEVICES)
+		return -1;
+	tsenseDevice_t *dev = &m_devices[m_num_devices];
+	memcpy(dev->addr,addr,8);
+	dev->family = addr[DSROM_FAMILY];
+	dev->resolution = res;
+	dev->known = known;
+	dev->status = TSENSE_ERROR_PENDING;
+	dev->raw = 0;
+	dev->reads = 0;
+	dev->err_score = 0;
+	dev->full_reads = 0;
+	dev->online = 1;
+	dev->alarm = 0;
+	#if TSENSE_WITH_HISTORY
+		m_history[m_num_devices].clear();
+	#endif
+	return m_num_devices++;
+		// incremented last for readers in other tasks
+}
+
+
+int myTempSensor::findDevice(const uint8_t *addr)
+{
+	for (int i=0; i<m_num_devices; i++)
+	{
+		if (!memcmp(addr,m_devices[i].addr,8))
+			return i;
+	}
+	return -1;
+}
+
+
 int myTempSensor::tsenseError(int err_code, const uint8_t *addr)
+	// Reports each error code at most once per TSENSE_ERROR_LOG_MS,
+	// with the number of reports suppressed since the last one.
 {
-	my_error("TSENSE_ERROR(%d,%s)%s%s",
+	m_last_error = err_code;
+
+	int suppressed = 0;
+	if (err_code > 0 && err_code < TSENSE_NUM_ERRORS)
+	{
+		uint16_t mask = 1 << err_code;
+		uint32_t now = millis();
+		if ((m_err_logged & mask) &&
+			now - m_err_time[err_code] < TSENSE_ERROR_LOG_MS)
+		{
+			m_err_suppressed[err_code]++;
+			return err_code;
+		}
+		m_err_logged |= mask;
+		m_err_time[err_code] = now;
+		suppressed = m_err_suppressed[err_code];
+		m_err_suppressed[err_code] = 0;
+	}
+
+	char buf[17];
+	my_error("TSENSE_ERROR(%d,%s)%s%s suppressed(%d)",
 		 err_code,
 		 errString(err_code),
 		 addr ? " addr=" : "",
-		 addr ? addrToStr(addr).c_str() : "");
-	m_last_error = err_code;
+		 addr ? addrToStr(addr,buf) : "",
+		 suppressed);
 	return err_code;
 }
 
@@ -385,22 +783,99 @@ int myTempSensor::getResolution(const uint8_t *addr)
 
 int myTempSensor::readScratchPad(const uint8_t *addr, uint8_t *scratch_pad)
 {
-	if (!one_wire.reset())
+	if (!m_bus->reset())
 		return tsenseError(TSENSE_ERROR_NO_DEVICES,addr);
 
-	one_wire.select(addr);
-	one_wire.write(READSCRATCH);
+	m_bus->select(addr);
+	m_bus->write(READSCRATCH);
 
 	for (uint8_t i = 0; i < 9; i++)
 	{
-		scratch_pad[i] = one_wire.read();
+		scratch_pad[i] = m_bus->read();
+	}
+
+	return checkScratchPad(addr,scratch_pad,m_bus->reset());
+}
+
+
+int myTempSensor::writeScratchPad(const uint8_t *addr, uint8_t th, uint8_t tl, uint8_t config, bool persist)
+{
+	if (!m_bus->reset())
+		return tsenseError(TSENSE_ERROR_NO_DEVICES,addr);
+
+	m_bus->select(addr);
+	m_bus->write(WRITESCRATCH);
+	m_bus->write(th);
+	m_bus->write(tl);
+	if (addr[DSROM_FAMILY] != DS18S20MODEL)
+		m_bus->write(config);
+
+	if (persist)
+	{
+		if (!m_bus->reset())
+			return tsenseError(TSENSE_ERROR_OFFLINE,addr);
+		m_bus->select(addr);
+		m_bus->write(COPYSCRATCH, m_parasite);
+			// strong pullup during the EEPROM write if parasite
+		delay(COPYSCRATCH_MS);
+		if (m_parasite)
+			m_bus->depower();
 	}
 
-	if (!one_wire.reset())
+	if (!m_bus->reset())
+		return tsenseError(TSENSE_ERROR_OFFLINE,addr);
+	return TSENSE_OK;
+}
+
+
+bool myTempSensor::readPowerSupply()
+	// returns false if any device on the bus uses parasite power
+{
+	if (!m_bus->reset())
+		return true;
+	m_bus->skip();
+	m_bus->write(READPOWERSUPPLY);
+	bool powered = m_bus->read_bit();
+	m_bus->reset();
+	return powered;
+}
+
+
+int myTempSensor::readFast(const uint8_t *addr, uint8_t *scratch_pad)
+{
+	if (!m_bus->reset())
+		return tsenseError(TSENSE_ERROR_NO_DEVICES,addr);
+
+	m_bus->select(addr);
+	m_bus->write(READSCRATCH);
+	scratch_pad[TEMP_LSB] = m_bus->read();
+	scratch_pad[TEMP_MSB] = m_bus->read();
+
+	return checkFast(addr,scratch_pad,m_bus->reset());
+		// the reset terminates the read
+}
+
+
+int myTempSensor::checkFast(const uint8_t *addr, const uint8_t *scratch_pad, bool present)
+	// without a CRC all we can catch is a device that
+	// did not answer, which reads as all ones, so those
+	// are left to a full read to tell from -0.0625C
+{
+	if (!present)
+		return tsenseError(TSENSE_ERROR_OFFLINE,addr);
+	if (scratch_pad[TEMP_LSB] == 0xff && scratch_pad[TEMP_MSB] == 0xff)
+		return TSENSE_REREAD;
+	return TSENSE_OK;
+}
+
+
+int myTempSensor::checkScratchPad(const uint8_t *addr, const uint8_t *scratch_pad, bool present)
+{
+	if (!present)
 		return tsenseError(TSENSE_ERROR_OFFLINE,addr);
 	if (!memcmp(scratch_pad,empty_pad,9))
 		return tsenseError(TSENSE_ERROR_EMPTY_DATA,addr);
-	if (OneWire::crc8(scratch_pad, 8) != scratch_pad[SCRATCHPAD_CRC])
+	if (myOneWire::crc8(scratch_pad, 8) != scratch_pad[SCRATCHPAD_CRC])
 		return tsenseError(TSENSE_ERROR_BAD_CRC,addr);
 
 	return TSENSE_OK;
@@ -408,4 +883,564 @@ int myTempSensor::readScratchPad(const uint8_t *addr, uint8_t *scratch_pad)
 
 
 
+//-------------------------------------------------
+// non-blocking sweeps
+//-------------------------------------------------
+
+void myTempSensor::startSweeps(uint32_t interval_ms/*=0*/)
+{
+	m_sweep_interval = interval_ms;
+	m_sweep_start = millis() - interval_ms;
+	m_sweeping = 1;
+}
+
+
+bool myTempSensor::sweepOnce()
+{
+	if (m_sweep_state != SWEEP_IDLE)
+		return false;
+	m_sweep_state = SWEEP_CONVERT;
+	return true;
+}
+
+
+bool myTempSensor::sweepBusy()
+{
+	return m_sweep_state != SWEEP_IDLE;
+}
+
+
+void myTempSensor::stopSweeps()
+{
+	m_sweeping = 0;
+}
+
+
+void myTempSensor::publish(int handle, int16_t raw, int status)
+	// seqlock: readers retry if seq is odd or changes under them
+{
+	tsenseDevice_t *dev = &m_devices[handle];
+	dev->status = status;
+	if (status == TSENSE_OK)
+		dev->raw = raw;
+
+	tsenseSnapshot_t *snap = &m_snapshots[handle];
+	snap->seq++;
+	__sync_synchronize();
+	if (status == TSENSE_OK)
+		snap->raw = raw;
+	snap->status = status;
+	snap->time = millis();
+	__sync_synchronize();
+	snap->seq++;
+
+	#if TSENSE_WITH_HISTORY
+		if (status == TSENSE_OK)
+			m_history[handle].add(raw,snap->time);
+	#endif
+}
+
+
+bool myTempSensor::getSnapshot(int handle, int16_t *raw, uint8_t *status/*=NULL*/, uint32_t *time/*=NULL*/)
+{
+	if (handle < 0 || handle >= m_num_devices)
+		return false;
+
+	tsenseSnapshot_t *snap = &m_snapshots[handle];
+	tsenseSnapshot_t copy;
+	uint32_t seq;
+	do
+	{
+		seq = snap->seq;
+		__sync_synchronize();
+		copy.raw = snap->raw;
+		copy.status = snap->status;
+		copy.time = snap->time;
+		__sync_synchronize();
+	}	while ((seq & 1) || seq != snap->seq);
+
+	if (!seq)
+		return false;
+	*raw = copy.raw;
+	if (status)
+		*status = copy.status;
+	if (time)
+		*time = copy.time;
+	return true;
+}
+
+
+#if TSENSE_WITH_HISTORY
+	const myTempHistory *myTempSensor::getHistory(int handle)
+	{
+		if (handle < 0 || handle >= m_num_devices)
+			return NULL;
+		return &m_history[handle];
+	}
+#endif
+
+
+bool myTempSensor::loop()
+{
+	switch (m_sweep_state)
+	{
+		case SWEEP_IDLE:
+			if (m_rescan_interval &&
+				millis() - m_rescan_start >= m_rescan_interval)
+			{
+				m_rescan_start = millis();
+				scanStart(false);
+				return false;
+			}
+			if (!m_sweeping ||
+				millis() - m_sweep_start < m_sweep_interval)
+				return false;
+			m_sweep_start = millis();
+			m_sweep_state = SWEEP_CONVERT;
+			return false;
+
+		case SWEEP_CONVERT:
+			m_last_error = 0;
+			if (!m_num_devices || !m_bus->reset())
+			{
+				tsenseError(TSENSE_ERROR_NO_DEVICES,NULL);
+				m_sweep_state = SWEEP_IDLE;
+				return true;
+			}
+			m_bus->skip();
+			m_bus->write(STARTCONVO, m_parasite);
+			m_pending = millis();
+			m_sweep_state = SWEEP_WAIT;
+			return true;
+
+		case SWEEP_WAIT:
+			if (pending())
+				return false;
+			m_sweep_alarm = m_alarm_sweeps;
+			if (m_sweep_alarm)
+			{
+				for (int i=0; i<m_num_devices; i++)
+					m_devices[i].alarm = 0;
+				scanStart(true);
+				return false;
+			}
+			m_sweep_dev = 0;
+			m_sweep_state = SWEEP_RESET;
+			return false;
+
+		case SWEEP_RESET:
+		{
+			if (m_sweep_dev >= m_num_devices)
+			{
+				m_sweep_count++;
+				m_sweep_state = SWEEP_IDLE;
+				return false;
+			}
+			const tsenseDevice_t *dev = &m_devices[m_sweep_dev];
+			if (!dev->online ||
+				(m_sweep_alarm && !dev->alarm && dev->status == TSENSE_OK))
+			{
+				// in alarm sweeps, in range devices that
+				// already have a value are not read
+				m_sweep_dev++;
+				return false;
+			}
+			const uint8_t *addr = m_devices[m_sweep_dev].addr;
+			if (!m_bus->reset())
+			{
+				publish(m_sweep_dev,0,tsenseError(TSENSE_ERROR_NO_DEVICES,addr));
+				m_sweep_dev++;
+				return true;
+			}
+			m_tx[0] = MATCHROM;
+			memcpy(&m_tx[1],addr,8);
+			m_tx[9] = READSCRATCH;
+			m_tx_len = 10;
+			m_tx_pos = 0;
+			m_sweep_full = m_sweep_retry || useFullRead(&m_devices[m_sweep_dev]);
+			m_sweep_retry = 0;
+			m_rx_len = m_sweep_full ? 9 : 2;
+			m_rx_pos = 0;
+			m_sweep_state = SWEEP_XFER;
+			return true;
+		}
+
+		case SWEEP_XFER:
+			for (int i=0; i<TSENSE_BYTES_PER_STEP; i++)
+			{
+				if (m_tx_pos < m_tx_len)
+					m_bus->write(m_tx[m_tx_pos++]);
+				else if (m_rx_pos < m_rx_len)
+					m_rx[m_rx_pos++] = m_bus->read();
+				if (m_tx_pos == m_tx_len && m_rx_pos == m_rx_len)
+				{
+					m_sweep_state = SWEEP_DONE;
+					break;
+				}
+			}
+			return true;
+
+		case SWEEP_DONE:
+		{
+			const uint8_t *addr = m_devices[m_sweep_dev].addr;
+			bool present = m_bus->reset();
+			int rslt = m_sweep_full ?
+				checkScratchPad(addr,m_rx,present) :
+				checkFast(addr,m_rx,present);
+			if (rslt != TSENSE_REREAD)
+				rslt = finishRead(m_sweep_dev,m_sweep_full,m_rx,rslt);
+
+			// a suspect fast read is re-read in full
+			// right away by staying on the same device
+
+			if ((rslt == TSENSE_ERROR_SUSPECT || rslt == TSENSE_REREAD) && !m_sweep_full)
+			{
+				m_sweep_retry = 1;
+				m_sweep_state = SWEEP_RESET;
+				return true;
+			}
+
+			publish(m_sweep_dev,m_devices[m_sweep_dev].raw,rslt);
+			m_sweep_dev++;
+			m_sweep_state = SWEEP_RESET;
+			return true;
+		}
+
+		case SWEEP_SCAN:
+			if (m_scan_last_device)
+			{
+				scanFinish();
+				return false;
+			}
+			if (!m_bus->reset())
+			{
+				// an empty bus; everything has departed
+				scanFinish();
+				return true;
+			}
+			m_bus->write(m_scan_alarm ? ALARMSEARCH : SEARCHROM);
+			m_scan_bit = 0;
+			m_scan_last_zero = 0;
+			m_sweep_state = SWEEP_SCAN_BITS;
+			return true;
+
+		case SWEEP_SCAN_BITS:
+			for (int i=0; i<TSENSE_SEARCH_BITS_PER_STEP; i++)
+			{
+				if (!scanBit())
+				{
+					// No device answered. For an alarm search that
+					// normally means there are no (more) alarms.
+					// For a re-scan the bus changed under the search,
+					// so it is tried again at the next interval.
+
+					if (m_scan_alarm)
+						scanFinish();
+					else
+						m_sweep_state = SWEEP_IDLE;
+					return true;
+				}
+				if (m_scan_bit == 64)
+				{
+					m_scan_last_discrepancy = m_scan_last_zero;
+					m_scan_last_device = !m_scan_last_zero;
+					scanFound();
+					m_sweep_state = SWEEP_SCAN;
+					break;
+				}
+			}
+			return true;
+	}
+	return false;
+}
+
+
+//-------------------------------------------------
+// incremental re-scan and alarm search
+//-------------------------------------------------
+// The ROM search of the OneWire library, split up into
+// steps of TSENSE_SEARCH_BITS_PER_STEP bits.
+
+void myTempSensor::setRescan(uint32_t interval_ms)
+{
+	m_rescan_interval = interval_ms;
+	m_rescan_start = millis();
+}
+
+
+void myTempSensor::scanStart(bool alarm)
+{
+	m_scan_alarm = alarm;
+	m_scan_last_discrepancy = 0;
+	m_scan_last_device = 0;
+	memset(m_scan_seen,0,sizeof(m_scan_seen));
+	m_sweep_state = SWEEP_SCAN;
+}
+
+
+bool myTempSensor::scanBit()
+	// one search triplet; returns false if no device answered
+{
+	uint8_t id_bit = m_bus->read_bit();
+	uint8_t cmp_id_bit = m_bus->read_bit();
+	if (id_bit && cmp_id_bit)
+		return false;
+
+	int bit = m_scan_bit;
+	uint8_t mask = 1 << (bit & 7);
+	uint8_t *byte = &m_scan_rom[bit >> 3];
+	bool dir;
+	if (id_bit != cmp_id_bit)
+		dir = id_bit;
+	else
+	{
+		if (bit + 1 < m_scan_last_discrepancy)
+			dir = (*byte & mask) != 0;
+		else
+			dir = bit + 1 == m_scan_last_discrepancy;
+		if (!dir)
+			m_scan_last_zero = bit + 1;
+	}
+
+	if (dir)
+		*byte |= mask;
+	else
+		*byte &= ~mask;
+	m_bus->write_bit(dir);
+	m_scan_bit++;
+	return true;
+}
+
+
+void myTempSensor::scanFound()
+	// a complete ROM from the search
+{
+	const uint8_t *addr = m_scan_rom;
+	if (myOneWire::crc8(addr,7) != addr[DSROM_CRC] ||
+		!validFamily(addr[DSROM_FAMILY]))
+		return;
+
+	int handle = findDevice(addr);
+	if (m_scan_alarm)
+	{
+		if (handle >= 0)
+			m_devices[handle].alarm = 1;
+		return;
+	}
+	if (handle >= 0)
+	{
+		m_scan_seen[handle] = 1;
+		if (!m_devices[handle].online)
+		{
+			m_devices[handle].online = 1;
+			postEvent(handle,TSENSE_EVENT_ARRIVED);
+		}
+		return;
+	}
+
+	// the resolution of a new device is left unknown, which
+	// is taken as 12 bits, rather than reading it here
+
+	handle = addDevice(addr,findKnownSensor(addr),0);
+	if (handle < 0)
+	{
+		warning(0,"MAX_TSENSE_DEVICES(%d) exceeded",MAX_TSENSE_DEVICES);
+		return;
+	}
+	m_scan_seen[handle] = 1;
+	setConversionMs();
+	postEvent(handle,TSENSE_EVENT_ARRIVED);
+}
+
+
+void myTempSensor::scanFinish()
+	// A complete pass. For an alarm search, go on to read the
+	// alarmed devices. For a re-scan, devices that were not seen
+	// have departed.
+{
+	if (m_scan_alarm)
+	{
+		m_sweep_dev = 0;
+		m_sweep_state = SWEEP_RESET;
+		return;
+	}
 
+	m_sweep_state = SWEEP_IDLE;
+	m_rescan_count++;
+	for (int i=0; i<m_num_devices; i++)
+	{
+		if (m_devices[i].online && !m_scan_seen[i])
+		{
+			m_devices[i].online = 0;
+			publish(i,m_devices[i].raw,TSENSE_ERROR_OFFLINE);
+			postEvent(i,TSENSE_EVENT_DEPARTED);
+		}
+	}
+}
+
+
+void myTempSensor::postEvent(int handle, int type)
+	// single producer loop(), single consumer getEvent()
+{
+	int next = (m_event_head + 1) % TSENSE_MAX_EVENTS;
+	if (next == m_event_tail)
+	{
+		warning(0,"tsense event queue full",0);
+		return;
+	}
+	m_events[m_event_head].handle = handle;
+	m_events[m_event_head].type = type;
+	m_event_head = next;
+}
+
+
+bool myTempSensor::getEvent(tsenseEvent_t *event)
+{
+	if (m_event_tail == m_event_head)
+		return false;
+	*event = m_events[m_event_tail];
+	m_event_tail = (m_event_tail + 1) % TSENSE_MAX_EVENTS;
+	return true;
+}
+
+
+#ifdef ESP32
+
+	static void sweepTask(void *param)
+	{
+		myTempSensor *self = (myTempSensor *) param;
+		while (1)
+		{
+			self->loop();
+			vTaskDelay(1);
+		}
+	}
+
+	void myTempSensor::startTask(int core/*=0*/, int priority/*=2*/)
+	{
+		xTaskCreatePinnedToCore(
+			sweepTask,
+			"tsenseTask",
+			4096,	// stack
+			this,	// param
+			priority,
+			NULL,   // handle
+			core);
+	}
+
+#endif
+
+
+
+//-------------------------------------------------
+// myTempSensorGroup
+//-------------------------------------------------
+
+myTempSensorGroup::myTempSensorGroup() :
+	m_num_sensors(0),
+	m_next(0),
+	m_sweeping(0),
+	m_sweep_started(0),
+	m_sweep_interval(0),
+	m_sweep_start(0),
+	m_sweep_count(0)
+{}
+
+
+int myTempSensorGroup::add(myTempSensor *sensor)
+{
+	if (m_num_sensors >= TSENSE_MAX_BUSES)
+	{
+		warning(0,"TSENSE_MAX_BUSES(%d) exceeded",TSENSE_MAX_BUSES);
+		return -1;
+	}
+	m_sensors[m_num_sensors] = sensor;
+	return m_num_sensors++;
+}
+
+
+void myTempSensorGroup::startSweeps(uint32_t interval_ms/*=0*/)
+{
+	m_sweep_interval = interval_ms;
+	m_sweep_start = millis() - interval_ms;
+	m_sweeping = 1;
+}
+
+
+bool myTempSensorGroup::loop()
+{
+	bool busy = false;
+	for (int i=0; i<m_num_sensors; i++)
+		busy |= m_sensors[i]->sweepBusy();
+
+	if (!busy)
+	{
+		if (m_sweep_started)
+		{
+			m_sweep_started = 0;
+			m_sweep_count++;
+		}
+
+		// gives the sensors a chance to start a re-scan,
+		// which then runs through the steps below
+
+		for (int i=0; i<m_num_sensors; i++)
+			if (m_sensors[i]->loop() || m_sensors[i]->sweepBusy())
+				return false;
+
+		if (!m_num_sensors || !m_sweeping ||
+			millis() - m_sweep_start < m_sweep_interval)
+			return false;
+		m_sweep_start = millis();
+
+		// STARTCONVO on all the buses back to back,
+		// so that the conversions overlap
+
+		bool did = false;
+		for (int i=0; i<m_num_sensors; i++)
+			if (m_sensors[i]->sweepOnce())
+				did |= m_sensors[i]->loop();
+		m_sweep_started = 1;
+		return did;
+	}
+
+	// then one bounded step on the next bus that has something
+	// to do, so that the reads of the buses are interleaved
+
+	for (int n=0; n<m_num_sensors; n++)
+	{
+		myTempSensor *sensor = m_sensors[m_next];
+		if (++m_next >= m_num_sensors)
+			m_next = 0;
+		if (sensor->sweepBusy() && sensor->loop())
+			return true;
+	}
+	return false;
+}
+
+
+#ifdef ESP32
+
+	static void groupTask(void *param)
+	{
+		myTempSensorGroup *self = (myTempSensorGroup *) param;
+		while (1)
+		{
+			self->loop();
+			vTaskDelay(1);
+		}
+	}
+
+	void myTempSensorGroup::startTask(int core/*=0*/, int priority/*=2*/)
+	{
+		xTaskCreatePinnedToCore(
+			groupTask,
+			"tsenseGroup",
+			4096,	// stack
+			this,	// param
+			priority,
+			NULL,   // handle
+			core);
+	}
+
+#endif
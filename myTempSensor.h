@@ -5,10 +5,15 @@
 // on original DallasTemperature Arduino library.
 //
 // - Does not (?) support parasite power.
-// - Does not support alarms.
+// - setAlarms() programs the alarm thresholds of the devices, and
+//		setAlarmSweeps() uses them to only read the devices that
+//		are out of range.
 // - Assumes a bus, and is not optimized for a single sensor.
-// - Cannot currently be used to set the resolution of programmable devices.
-//		all of mine default to 12 bits (750ms required)
+// - setResolution() may be used to program the resolution of devices,
+//		all of mine default to 12 bits (750ms required). The pending()
+//		timeout follows the highest resolution on the bus.
+// - if no devices use parasite power, pending() polls the bus
+//		and ends as soon as all conversions are complete.
 //
 // In this implementation, you MUST know the 8 byte address of the
 //		sensors you are using.
@@ -28,16 +33,96 @@
 //				This will actually give you the PREVIOUS measurement.
 // 			measure().  This will send out the command
 //				for all temperature sensors to do a measurement
-//      		and set the m_pending 800 ms timer for the
-//				next time through.
+//      		and set the m_pending timer (800 ms at 12 bits)
+//				for the next time through.
 //		}
 //
+// Instead of getDegreesC() for each address, readAll() reads all
+// the devices into arrays of raw 1/128 degree values and status
+// codes in one call, without floats.
+//
 // Note that Devices may go off/online due to faulty wiring.
+//
+// init() also keeps a table of the valid devices it finds, and
+// hands out small integer handles (0..getNumDevices()-1) for them,
+// which avoid parsing the address string on every read.
+//
+// Non-blocking sweeps:
+//
+// As an alternative to the above, startSweeps() and loop() sweep all
+// the devices in the table in small bounded steps, each of which is
+// a bus reset or at most TSENSE_BYTES_PER_STEP bytes on the bus, and
+// which never wait for the conversion. Each result is published to a
+// per device snapshot that getSnapshot() reads instantly, without
+// locks, from any task. loop() may be called from the application
+// loop(), or from a task with startTask() on an ESP32.
+// Do not call the blocking methods while sweeps are running.
+//
+// Read modes:
+//
+// By default every read fetches the whole 9 byte scratch pad and
+// checks its CRC. TSENSE_READ_FAST only reads the two temperature
+// bytes and ends the read with a bus reset, which takes about a
+// third of the bus time, but cannot detect corrupted data.
+// TSENSE_READ_ADAPTIVE reads fast, but audits every Nth read of a
+// device with a full read, and a device falls back to full reads
+// while its error score, from failed reads and implausible values,
+// is high. DS18S20's always need full reads.
+//
+// History:
+//
+// If TSENSE_WITH_HISTORY, each good reading from a sweep is also
+// added to a fixed size myTempHistory for the device, with a ring
+// of the recent samples and min/max/mean rollups, by default over
+// 1 second, 1 minute and 1 hour. See myTempHistory.h for the sizes.
+//
+// Alarm sweeps:
+//
+// With setAlarmSweeps(true), each sweep does a conditional (alarm)
+// search after the conversion, in the same bounded steps as the
+// re-scan below, and then only reads the devices that answered it,
+// those with a temperature >= their TH or <= their TL, along with
+// any device that does not have a good value yet. The snapshots and
+// history of in range devices are not updated, and keep the time of
+// their last actual read. Use setAlarms() to give each device a
+// band around its expected temperature. The power on thresholds of
+// most devices put them in alarm at room temperature, so that
+// devices whose thresholds have not been set are always read.
+//
+// Hot-plug:
+//
+// Devices go on and offline through bad wiring, and may be added
+// or removed. setRescan() runs the ROM search again every interval,
+// in steps of TSENSE_SEARCH_BITS_PER_STEP search bits, whenever the
+// sweep engine is idle. New devices are added to the table, devices
+// that are no longer found are marked offline and skipped by the
+// sweeps, and getEvent() returns an event for each arrival and
+// departure. Handles never change, so a device that comes back
+// keeps its handle.
+//
+// Multiple buses:
+//
+// Each myTempSensor owns its own bus, so sensors may be spread
+// over several pins to keep the buses short. A myTempSensorGroup
+// sweeps several of them together: it starts the conversions on
+// all the buses at once and then interleaves the bounded steps of
+// their reads, so that a sweep takes about as long as the largest
+// bus, rather than the sum of them. Call init() on each sensor,
+// add() them to the group, and then use the group's startSweeps()
+// and loop() or startTask() instead of those of the sensors.
 
 
 #pragma once
 
 #include <Arduino.h>
+#include "myOneWire.h"
+
+#ifndef TSENSE_WITH_HISTORY
+	#define TSENSE_WITH_HISTORY		1		// 516 bytes per device by default,
+#endif										// about 8KB for MAX_TSENSE_DEVICES
+#if TSENSE_WITH_HISTORY
+	#include "myTempHistory.h"
+#endif
 
 
 // Don't use the float if it >= TEMPERATURE_ERROR
@@ -56,13 +141,96 @@
 #define TSENSE_ERROR_BAD_CRC		5
 #define TSENSE_ERROR_BAD_CONFIG		6
 #define TSENSE_ERROR_PENDING		7
+#define TSENSE_ERROR_SUSPECT		8		// implausible fast read
+
+#define TSENSE_NUM_ERRORS			9
+
+#ifndef TSENSE_ERROR_LOG_MS
+	#define TSENSE_ERROR_LOG_MS		1000	// min ms between reports of the same error
+#endif
+
+// Hot-plug event types
+
+#define TSENSE_EVENT_ARRIVED		1
+#define TSENSE_EVENT_DEPARTED		2
+
+// Read modes
+
+#define TSENSE_READ_FULL			0
+#define TSENSE_READ_FAST			1
+#define TSENSE_READ_ADAPTIVE		2
+
+#ifndef TSENSE_AUDIT_READS
+	#define TSENSE_AUDIT_READS		16		// every Nth adaptive read is a full one
+#endif
+#ifndef TSENSE_ERROR_LIMIT
+	#define TSENSE_ERROR_LIMIT		8		// error score that forces full reads
+#endif
+#ifndef TSENSE_MAX_JUMP
+	#define TSENSE_MAX_JUMP			(10 * 128)	// implausible change between fast reads
+#endif
+
+#ifndef MAX_TSENSE_DEVICES
+	#define MAX_TSENSE_DEVICES		16
+#endif
+#ifndef TSENSE_SEARCH_BITS_PER_STEP
+	#define TSENSE_SEARCH_BITS_PER_STEP	8	// about 210us per bit
+#endif
+#ifndef TSENSE_MAX_EVENTS
+	#define TSENSE_MAX_EVENTS		8		// size of the hot-plug event queue
+#endif
+#ifndef TSENSE_MAX_BUSES
+	#define TSENSE_MAX_BUSES		4		// myTempSensors per myTempSensorGroup
+#endif
+#ifndef TSENSE_BYTES_PER_STEP
+	#define TSENSE_BYTES_PER_STEP	3		// about 210us per byte
+#endif
+
+
+typedef struct
+{
+	uint8_t addr[8];		// binary ROM
+	uint8_t family;			// addr[0]
+	uint8_t resolution;		// 9..12 or 0 if unknown
+	uint8_t known;			// 1 based KNOWN_SENSORS number or 0
+	uint8_t status;			// TSENSE_OK or error from the last read
+	int16_t raw;			// last value in 1/128 degrees C
+	uint8_t reads;			// counter for adaptive audits
+	uint8_t err_score;		// adaptive error score
+	bool full_reads;		// adaptive fallback to full reads
+	bool online;			// found by the last search
+	bool alarm;				// answered the last alarm search
+} tsenseDevice_t;
+
+
+typedef struct
+{
+	uint8_t handle;
+	uint8_t type;			// TSENSE_EVENT_ARRIVED or _DEPARTED
+} tsenseEvent_t;
+
+
+typedef struct
+	// written only by loop(), read by getSnapshot()
+{
+	volatile uint32_t seq;	// odd while being written
+	int16_t raw;			// 1/128 degrees C
+	uint8_t status;			// TSENSE_OK or error code
+	uint32_t time;			// millis() of the read
+} tsenseSnapshot_t;
 
 
 class myTempSensor
 {
 public:
 
-	myTempSensor(int one_wire_pin);
+	#ifndef MY_HOST_BUILD
+		myTempSensor(int one_wire_pin);
+			// creates and owns a OneWire bus on the pin
+	#endif
+	myTempSensor(myOneWire *bus);
+		// uses the given bus, i.e. a simulator, which it does not own
+	~myTempSensor();
 
 	int init();
 		// returns TSENSE_OK or reports error and returns error code
@@ -72,8 +240,9 @@ public:
 		// can return errors but they *msy* be ignored, since
 		// each measurement is a new oneWire request
 	bool pending();
-		// returns true if a measurement is pending
-		// 800ms timeout period.
+		// returns true if a measurement is pending, until the
+		// conversion time for the highest resolution on the bus
+		// has passed, or polling says all conversions are done.
 
 	int measure();
 		// returns TSENSE_OK or reports error and returns error code
@@ -83,8 +252,82 @@ public:
 	float getDegreesC(const char *saddr);
 		// Return the temperature for a given sensor
 		// or TEMPERATURE_ERROR if pending or any problems
+	float getDegreesC(int handle);
+		// same, for a device from the table, without parsing
+	int readAll(int16_t *raw, uint8_t *status, int max);
+		// Reads the previous measurement of up to max devices, by
+		// handle, into raw, in 1/128 degrees C, and status, and
+		// returns the number of devices. raw[i] is only valid if
+		// status[i] == TSENSE_OK. No floats, and no heap.
+	int getSnapshots(int16_t *raw, uint8_t *status, int max);
+		// the same from the sweep snapshots, without touching the
+		// bus; devices that have not been read yet are PENDING
+
+	int setResolution(int handle, int bits, bool persist=false);
+		// sets the resolution, 9..12, of a device, or all devices if
+		// handle == -1, saving it to the device EEPROM if persist.
+		// DS18S20's are fixed at 12 bits and are skipped.
+		// returns TSENSE_OK or reports and returns an error code
+	int setAlarms(int handle, int8_t high_c, int8_t low_c, bool persist=false);
+		// sets the TH and TL alarm thresholds, in whole degrees C, of
+		// a device, or all devices if handle == -1, saving them to the
+		// device EEPROM if persist. A device is in alarm when its
+		// temperature is >= high_c or <= low_c.
+		// returns TSENSE_OK or reports and returns an error code
+	void setAlarmSweeps(bool alarm)  { m_alarm_sweeps = alarm; }
+		// read only the devices in alarm during sweeps
+	void setReadMode(int mode)  { m_read_mode = mode; }
+		// TSENSE_READ_FULL (default), _FAST, or _ADAPTIVE
+	int getReadMode()  { return m_read_mode; }
+	void setPollReady(bool poll)  { m_poll_ready = poll; }
+		// default true; poll for conversion complete unless
+		// a device uses parasite power
+	bool isParasite()  { return m_parasite; }
+		// true if any device uses parasite power
+	uint32_t getConversionMs()  { return m_conversion_ms; }
+
+	int getNumDevices()  { return m_num_devices; }
+	int getHandle(const char *saddr);
+		// returns the handle of the device or -1 if not found
+	const tsenseDevice_t *getDevice(int handle);
+		// returns NULL for an invalid handle
+
+	// non-blocking sweeps
+
+	void startSweeps(uint32_t interval_ms=0);
+		// start a sweep every interval_ms, or back to back if 0
+	void stopSweeps();
+		// stops after the current sweep
+	bool loop();
+		// advances the sweep by one bounded step and
+		// returns true if it did anything on the bus
+	bool getSnapshot(int handle, int16_t *raw, uint8_t *status=NULL, uint32_t *time=NULL);
+		// returns false for an invalid handle or if the device has
+		// not been read yet. Otherwise status says if raw is valid.
+	#if TSENSE_WITH_HISTORY
+		const myTempHistory *getHistory(int handle);
+			// returns NULL for an invalid handle
+	#endif
+	uint32_t getSweepCount()  { return m_sweep_count; }
+		// number of completed sweeps
+	void setRescan(uint32_t interval_ms);
+		// re-scan the bus every interval_ms when idle, 0 to turn off
+	bool getEvent(tsenseEvent_t *event);
+		// returns false if there are no hot-plug events
+	uint32_t getRescanCount()  { return m_rescan_count; }
+		// number of completed re-scans
+	bool sweepOnce();
+		// starts a single sweep, returns false if one is in progress
+	bool sweepBusy();
+		// true while a sweep is in progress
+
+	#ifdef ESP32
+		void startTask(int core=0, int priority=2);
+			// calls loop() once per tick from a task
+	#endif
 	int getLastError() { return m_last_error; }
-		// call if any method fails
+		// call if any method fails. Errors are reported with
+		// myDebug, at most once per TSENSE_ERROR_LOG_MS per code.
 
 	static const char *errString(int err);
 		// return a string for the error code
@@ -92,21 +335,145 @@ public:
 
 private:
 
+	myOneWire *m_bus;
+	bool m_own_bus;
 	uint32_t m_pending;
 	int m_last_error;
+	bool m_parasite;
+	bool m_poll_ready;
+	uint32_t m_conversion_ms;
+	int m_read_mode;
+
+	void setConversionMs();
+	bool readPowerSupply();
+
+	int m_num_devices;
+	tsenseDevice_t m_devices[MAX_TSENSE_DEVICES];
+
+	int findDevice(const uint8_t *addr);
+	int addDevice(const uint8_t *addr, int known, int res);
+		// returns the new handle or -1 if the table is full
+
+	// sweep state machine
+
+	bool useFullRead(tsenseDevice_t *dev);
+	int readDevice(int handle);
+		// blocking read of a device according to the read mode
+	int finishRead(int handle, bool full, const uint8_t *scratch_pad, int rslt);
+		// common to readDevice() and loop(); applies the adaptive policy,
+		// and updates the device from a read with the given result
+
+	bool m_sweeping;
+	int m_sweep_state;
+	uint32_t m_sweep_interval;
+	uint32_t m_sweep_start;
+	uint32_t m_sweep_count;
+	int m_sweep_dev;
+	bool m_sweep_full;
+	bool m_sweep_retry;
+	uint8_t m_tx[10];		// MATCHROM, addr, READSCRATCH
+	int m_tx_len;
+	int m_tx_pos;
+	int m_rx_len;
+	int m_rx_pos;
+	uint8_t m_rx[9];
+	tsenseSnapshot_t m_snapshots[MAX_TSENSE_DEVICES];
+	#if TSENSE_WITH_HISTORY
+		myTempHistory m_history[MAX_TSENSE_DEVICES];
+	#endif
+
+	bool m_alarm_sweeps;
+	bool m_sweep_alarm;		// m_alarm_sweeps for the current sweep
+
+	// re-scan and alarm search state
+
+	uint32_t m_rescan_interval;
+	uint32_t m_rescan_start;
+	uint32_t m_rescan_count;
+	uint8_t m_scan_rom[8];
+	int m_scan_bit;
+	int m_scan_last_zero;
+	int m_scan_last_discrepancy;
+	bool m_scan_last_device;
+	bool m_scan_alarm;		// an alarm search, rather than a re-scan
+	bool m_scan_seen[MAX_TSENSE_DEVICES];
+
+	void scanStart(bool alarm);
+	bool scanBit();
+	void scanFound();
+	void scanFinish();
+
+	tsenseEvent_t m_events[TSENSE_MAX_EVENTS];
+	volatile int m_event_head;
+	volatile int m_event_tail;
+	void postEvent(int handle, int type);
+
+	void publish(int handle, int16_t raw, int status);
 
 	int getResolution(const uint8_t *addr);
 		// returns 9..12 or 0 upon an error
 	int readScratchPad(const uint8_t *addr, uint8_t *scratch_pad);
 		// returns TSENSE_OK or reports and returns error code
+	int writeScratchPad(const uint8_t *addr, uint8_t th, uint8_t tl, uint8_t config, bool persist);
+		// returns TSENSE_OK or reports and returns error code
+	int checkScratchPad(const uint8_t *addr, const uint8_t *scratch_pad, bool present);
+		// checks a scratch pad that has been read, where present is
+		// the result of the terminating reset
+	int readFast(const uint8_t *addr, uint8_t *scratch_pad);
+		// reads only TEMP_LSB and TEMP_MSB
+	int checkFast(const uint8_t *addr, const uint8_t *scratch_pad, bool present);
 	int tsenseError(int err_code, const uint8_t *addr);
 		// reports and returns the error; addr may be NULL
 
+	uint16_t m_err_logged;	// bit per error code
+	uint32_t m_err_time[TSENSE_NUM_ERRORS];
+	uint16_t m_err_suppressed[TSENSE_NUM_ERRORS];
+
 };
 
 
 
 
+class myTempSensorGroup
+	// sweeps several myTempSensors, each on its own bus, together
+{
+public:
+
+	myTempSensorGroup();
+
+	int add(myTempSensor *sensor);
+		// returns the index of the sensor or -1 if full
+
+	void startSweeps(uint32_t interval_ms=0);
+	void stopSweeps()  { m_sweeping = 0; }
+		// stops after the current sweep
+	bool loop();
+		// advances the sweep by one bounded step on one bus, except
+		// at the start of a sweep, which starts the conversions on
+		// all of them. Returns true if it did anything on a bus.
+	uint32_t getSweepCount()  { return m_sweep_count; }
+		// number of completed sweeps of all the buses
+
+	#ifdef ESP32
+		void startTask(int core=0, int priority=2);
+			// calls loop() once per tick from a task
+	#endif
+
+private:
+
+	int m_num_sensors;
+	myTempSensor *m_sensors[TSENSE_MAX_BUSES];
+	int m_next;
+	bool m_sweeping;
+	bool m_sweep_started;
+	uint32_t m_sweep_interval;
+	uint32_t m_sweep_start;
+	uint32_t m_sweep_count;
+
+};
+
+
+
 //-----------------------------------------------------------
 // My devices
 //-----------------------------------------------------------